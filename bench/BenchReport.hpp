@@ -0,0 +1,65 @@
+#ifndef _BenchReport_hpp_
+#define _BenchReport_hpp_
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE ""
+#endif
+
+/// @brief 基准结果输出
+/// 缺省每项输出一行便于阅读的文本；命令行带 --json 时每项输出一行 JSON（JSON Lines）：
+///   {"suite": "...", "name": "...", "value": 1.23, "unit": "ns/packet", "build": "Release"}
+/// bench 目标只收集以 { 开头的行，库内部打印到标准输出的提示不影响结果文件
+class BenchReport
+{
+public:
+    BenchReport(const char *suite_name, int argc, char const *argv[]) : suite(suite_name)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--json") == 0)
+                this->json = true;
+            else
+                this->args.push_back(argv[i]);
+        }
+    }
+
+    /// 第 index 个非选项参数，没有时为 fallback
+    std::string arg(size_t index, const std::string &fallback) const
+    {
+        return index < this->args.size() ? this->args[index] : fallback;
+    }
+
+    void add(const std::string &name, double value, const char *unit) const
+    {
+        if (!std::isfinite(value))
+            value = 0;
+        if (this->json)
+            std::printf("{\"suite\": \"%s\", \"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"build\": \"%s\"}\n",
+                        this->suite.c_str(), name.c_str(), value, unit, BENCH_BUILD_TYPE);
+        else
+            std::printf("%-40s %14.3f %s\n", name.c_str(), value, unit);
+        std::fflush(stdout);
+    }
+
+    /// 百分位（0~100），samples 会被排序
+    static double percentile(std::vector<double> &samples, double p)
+    {
+        if (samples.empty())
+            return 0;
+        std::sort(samples.begin(), samples.end());
+        auto index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+        return samples[std::min(index, samples.size() - 1)];
+    }
+
+private:
+    std::string suite;
+    bool json = false;
+    std::vector<std::string> args;
+};
+#endif
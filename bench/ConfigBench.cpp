@@ -0,0 +1,49 @@
+// 配置通知基准：ConfigBench [--json] [通知次数]
+// ConfigSubject 向不同数量的观察者同步扇出的耗时，以及异步分发的事件吞吐
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "Config.hpp"
+#include "BenchReport.hpp"
+
+int main(int argc, char const *argv[])
+{
+    using SteadyClock = std::chrono::steady_clock;
+    BenchReport report("config", argc, argv);
+    const size_t notifyCount = std::stoul(report.arg(0, "20000"));
+
+    for (size_t observers : {1, 16, 256})
+    {
+        ConfigSubject subject;
+        std::atomic<uint64_t> calls{0};
+        for (size_t i = 0; i < observers; i++)
+        {
+            subject.subscribe([&calls](const StateChangeEvent &)
+                              { calls.fetch_add(1, std::memory_order_relaxed); }, stateMask(StateType::ST_Update));
+            // 另一半观察者订阅其他状态，衡量按掩码跳过的开销
+            subject.subscribe([&calls](const StateChangeEvent &)
+                              { calls.fetch_add(1, std::memory_order_relaxed); }, stateMask(StateType::ST_Error));
+        }
+        StateChangeEvent event(StateType::ST_Update, 0, "config.json");
+
+        auto begin = SteadyClock::now();
+        for (size_t i = 0; i < notifyCount; i++)
+            subject.notifyAllObservers(event);
+        auto syncNs = std::chrono::duration<double, std::nano>(SteadyClock::now() - begin).count() / notifyCount;
+        report.add("notify_sync_" + std::to_string(observers) + "_observers", syncNs, "ns/notify");
+
+        // 异步：状态码各不相同，不会被合并
+        subject.setAsync(true);
+        calls = 0;
+        begin = SteadyClock::now();
+        for (size_t i = 0; i < notifyCount; i++)
+            subject.notifyAllObservers(StateChangeEvent(StateType::ST_Update, static_cast<int>(i)));
+        auto enqueueNs = std::chrono::duration<double, std::nano>(SteadyClock::now() - begin).count() / notifyCount;
+        subject.flush();
+        auto seconds = std::chrono::duration<double>(SteadyClock::now() - begin).count();
+        subject.setAsync(false);
+        report.add("notify_async_enqueue_" + std::to_string(observers) + "_observers", enqueueNs, "ns/notify");
+        report.add("notify_async_delivery_" + std::to_string(observers) + "_observers", calls / seconds, "callbacks/s");
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+// 日志基准：LogBench [--json] [每项调用次数]
+// LOG_* 调用点开销（文本、二进制、运行期关闭的级别）与包括后台写出在内的总吞吐
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include "LogTool.hpp"
+#include "BenchReport.hpp"
+
+int main(int argc, char const *argv[])
+{
+    using SteadyClock = std::chrono::steady_clock;
+    BenchReport report("log", argc, argv);
+    const size_t callCount = std::stoul(report.arg(0, "200000"));
+
+    auto logPath = (std::filesystem::temp_directory_path() / "LogBench.log").string();
+    auto &logger = LogTool::getInstance();
+    logger.setLogFile(logPath);
+    LogTool::setLevel(LogTool::DEBUG);
+
+    auto measure = [&](const char *name, auto &&call)
+    {
+        auto dropped = logger.droppedCount();
+        auto begin = SteadyClock::now();
+        for (size_t i = 0; i < callCount; i++)
+            call(i);
+        auto callNs = std::chrono::duration<double, std::nano>(SteadyClock::now() - begin).count() / callCount;
+        logger.flush();
+        auto seconds = std::chrono::duration<double>(SteadyClock::now() - begin).count();
+        report.add(std::string(name) + "_call", callNs, "ns/call");
+        report.add(std::string(name) + "_throughput", callCount / seconds, "lines/s");
+        // 线程缓冲区写满时丢弃的条数，非 0 说明调用点开销被丢弃拉低了
+        report.add(std::string(name) + "_dropped", double(logger.droppedCount() - dropped), "lines");
+    };
+
+    measure("log_text", [](size_t i)
+            { LOG_INFO("packet ", i, " from ", "127.0.0.1", ":", 9000, " parsed in ", 1.25, "us"); });
+    measure("log_binary", [](size_t i)
+            { LOG_BIN_INFO("packet {} from {}:{} parsed in {}us", i, "127.0.0.1", 9000, 1.25); });
+
+    // 运行期关闭的级别只剩一次原子读，参数不求值
+    LogTool::setLevel(LogTool::ERROR);
+    auto begin = SteadyClock::now();
+    for (size_t i = 0; i < callCount; i++)
+        LOG_DEBUG("packet ", i, " dropped");
+    report.add("log_disabled_call", std::chrono::duration<double, std::nano>(SteadyClock::now() - begin).count() / callCount, "ns/call");
+
+    logger.flush();
+    std::error_code ec;
+    std::filesystem::remove(logPath, ec);
+    std::filesystem::remove(logPath + ".bin", ec);
+    return 0;
+}
@@ -0,0 +1,180 @@
+// 网络基准：NetBench [--json] [UDP数据报数] [TCP总字节数(MB)] [起始端口]
+// UDP 回环吞吐（限制在途数量，不靠丢包撑吞吐）与单向时延，TCP 回环流吞吐
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SockKit.hpp"
+#include "BenchReport.hpp"
+
+namespace
+{
+    using SteadyClock = std::chrono::steady_clock;
+    const std::string loopback = "127.0.0.1";
+
+    // 等待条件成立，超时返回 false
+    template <typename Pred>
+    bool waitFor(Pred &&pred, std::chrono::milliseconds timeout)
+    {
+        auto deadline = SteadyClock::now() + timeout;
+        while (!pred())
+        {
+            if (SteadyClock::now() > deadline)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // 接收线程阻塞在 recvmmsg 中，关闭接收后再发一个数据报唤醒它
+    void stopReceiver(UdpSocket &receiver, UdpSocket &sender, int port)
+    {
+        receiver.recvSwitch(false);
+        sender.send("x", loopback, port);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    bool udpThroughput(const BenchReport &report, int port, size_t count)
+    {
+        constexpr size_t window = 128; ///< 最多在途的数据报数，默认接收缓冲区（约 200KB，每个数据报按 skb 占用计）放得下
+        std::atomic<size_t> received{0};
+        UdpSocket receiver(loopback, port);
+        UdpSocket sender(loopback, 0);
+        receiver.recvBatch([&received](PacketBatch &batch)
+                           { received += batch.size(); });
+        sender.setSendQueue(32, std::chrono::microseconds(100));
+        sockaddr_in destAddr;
+        SendQueue::resolve(loopback, port, destAddr);
+
+        const std::string message(64, 'u');
+        size_t sent = 0, lost = 0;
+        auto begin = SteadyClock::now();
+        auto progress = begin;
+        size_t lastReceived = 0;
+        while (sent < count)
+        {
+            auto t_received = received.load(std::memory_order_relaxed);
+            if (sent - t_received - lost >= window)
+            {
+                sender.flush();
+                // 长时间没有进展说明在途的数据报已丢失，记为丢包后继续，避免窗口永远占满
+                auto t_now = SteadyClock::now();
+                if (t_received != lastReceived)
+                {
+                    lastReceived = t_received;
+                    progress = t_now;
+                }
+                else if (t_now - progress > std::chrono::milliseconds(100))
+                {
+                    lost = sent - t_received;
+                    progress = t_now;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            sender.enqueue(message, destAddr);
+            sent++;
+        }
+        sender.flush();
+        waitFor([&]
+                { return received >= count; }, std::chrono::milliseconds(200));
+        auto seconds = std::chrono::duration<double>(SteadyClock::now() - begin).count();
+        stopReceiver(receiver, sender, port);
+
+        report.add("udp_loopback_throughput", received / seconds, "packets/s");
+        report.add("udp_loopback_loss", count ? double(count - std::min<size_t>(received, count)) / count * 100 : 0, "%");
+        return true;
+    }
+
+    bool udpLatency(const BenchReport &report, int port, size_t count)
+    {
+        std::atomic<size_t> received{0};
+        std::vector<double> samples;
+        samples.reserve(count);
+        UdpSocket receiver(loopback, port);
+        UdpSocket sender(loopback, 0);
+        receiver.recvBatch([&](PacketBatch &batch)
+                           {
+            auto now = SteadyClock::now().time_since_epoch().count();
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                int64_t t_sent;
+                if (batch.length(i) < sizeof(t_sent))
+                    continue;
+                std::memcpy(&t_sent, batch.data(i), sizeof(t_sent));
+                samples.push_back((now - t_sent) / 1000.0);
+                received++;
+            } });
+
+        // 一次只有一个数据报在途，测的是发送到接收回调的单向时延
+        std::string message(64, 'l');
+        for (size_t i = 0; i < count; i++)
+        {
+            int64_t t_now = SteadyClock::now().time_since_epoch().count();
+            std::memcpy(&message[0], &t_now, sizeof(t_now));
+            sender.send(message, loopback, port);
+            if (!waitFor([&]
+                         { return received > i; }, std::chrono::milliseconds(200)))
+            {
+                std::cerr << "UDP 时延测试丢包，已收到 " << received << "/" << count << std::endl;
+                break;
+            }
+        }
+        stopReceiver(receiver, sender, port);
+
+        report.add("udp_loopback_latency_p50", BenchReport::percentile(samples, 50), "us");
+        report.add("udp_loopback_latency_p99", BenchReport::percentile(samples, 99), "us");
+        report.add("udp_loopback_latency_max", BenchReport::percentile(samples, 100), "us");
+        return true;
+    }
+
+    bool tcpThroughput(const BenchReport &report, int port, size_t total_bytes)
+    {
+        std::atomic<size_t> received{0};
+        TcpSocket server(TcpModel::tm_server, loopback, port);
+        server.recv([&received](const PacketView &packet)
+                    { received += packet.length; });
+        TcpSocket client(TcpModel::tm_client, loopback, port);
+
+        const std::string chunk(64 * 1024, 't');
+        size_t sent = 0;
+        auto begin = SteadyClock::now();
+        while (sent < total_bytes)
+        {
+            if (client.send(chunk) <= 0)
+            {
+                std::cerr << "TCP 发送失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+                return false;
+            }
+            sent += chunk.size();
+        }
+        bool done = waitFor([&]
+                            { return received >= sent; }, std::chrono::seconds(10));
+        auto seconds = std::chrono::duration<double>(SteadyClock::now() - begin).count();
+        // 客户端先关闭，TIME_WAIT 留在客户端的临时端口上，不影响下次绑定服务端端口
+        client.close();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.close();
+
+        report.add("tcp_loopback_throughput", received / seconds / (1024 * 1024), "MB/s");
+        if (!done)
+            std::cerr << "TCP 吞吐测试超时，已收到 " << received << "/" << sent << std::endl;
+        return done;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    BenchReport report("network", argc, argv);
+    auto udpCount = std::stoul(report.arg(0, "200000"));
+    auto tcpBytes = std::stoul(report.arg(1, "512")) * 1024 * 1024;
+    auto port = std::stoi(report.arg(2, "39100"));
+
+    bool ok = udpThroughput(report, port, udpCount);
+    ok = udpLatency(report, port + 1, std::min<size_t>(udpCount, 20000)) && ok;
+    ok = tcpThroughput(report, port + 2, tcpBytes) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ProtocolParser.hpp"
+#include "BenchReport.hpp"
+#include "ClassifyIndex.hpp"
+#include "BenchDecoder.hpp"
+
+// 逐包遍历json的过滤实现（规则编译之前的做法），作为对比基线
+static bool jsonWalkFilter(const json &parserRule, const std::string &buffer)
+{
+    const json &filter = parserRule["filter"];
+    for (size_t i = 0; i < filter.size(); i++)
+    {
+        if (!filter[i]["enable"])
+            continue;
+        size_t offset = filter[i]["offset"];
+        size_t length = filter[i]["length"];
+        std::string type = filter[i]["type"];
+        std::string endian = filter[i].value("endian", "big");
+        if (offset + length > buffer.size())
+            return false;
+        uint64_t val = 0;
+        for (size_t j = 0; j < length; j++)
+        {
+            auto t_byte = static_cast<uint8_t>(buffer[offset + (endian == "big" ? j : length - 1 - j)]);
+            val = (val << 8) | t_byte;
+        }
+        if (type == "int")
+        {
+            auto shift = 64 - length * 8;
+            auto sval = length < 8 ? static_cast<int64_t>(val << shift) >> shift : static_cast<int64_t>(val);
+            if (sval != filter[i]["value"].get<int64_t>())
+                return false;
+        }
+        else if (val != filter[i]["value"].get<uint64_t>())
+            return false;
+    }
+    return true;
+}
+
+template <typename Func>
+static double nsPerPacket(const std::vector<std::string> &packets, int rounds, Func &&func, size_t &matched)
+{
+    matched = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const auto &t_packet : packets)
+            matched += func(t_packet) ? 1 : 0;
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / (double(rounds) * packets.size());
+}
+
+int main(int argc, char const *argv[])
+{
+    // 8个过滤条件，覆盖不同长度、符号与字节序
+    json rule = {
+        {"protocol-info", {{"name", "bench"}, {"description", "parser bench"}, {"version", "1.0"}}},
+        {"filter", json::array({
+                       {{"enable", true}, {"offset", 0}, {"length", 2}, {"type", "uint"}, {"value", 0xAA55}},
+                       {{"enable", true}, {"offset", 2}, {"length", 1}, {"type", "uint"}, {"value", 1}},
+                       {{"enable", true}, {"offset", 4}, {"length", 4}, {"type", "int"}, {"value", -2}},
+                       {{"enable", true}, {"offset", 8}, {"length", 4}, {"type", "uint"}, {"endian", "little"}, {"value", 1000}},
+                       {{"enable", false}, {"offset", 12}, {"length", 2}, {"type", "int"}, {"value", 7}},
+                       {{"enable", true}, {"offset", 16}, {"length", 8}, {"type", "uint"}, {"value", 42}},
+                       {{"enable", true}, {"offset", 24}, {"length", 2}, {"type", "int"}, {"endian", "little"}, {"value", -300}},
+                       {{"enable", true}, {"offset", 30}, {"length", 4}, {"type", "int"}, {"value", 123456}},
+                   })}};
+
+    // 生成数据包：一半完全匹配，一半在随机字节上不匹配
+    const int packetCount = 4096;
+    std::mt19937 rng(20241025);
+    std::vector<std::string> packets(packetCount, std::string(64, '\0'));
+    RuleProgram program(rule);
+    for (int i = 0; i < packetCount; i++)
+    {
+        auto &t_packet = packets[i];
+        for (auto &t_byte : t_packet)
+            t_byte = static_cast<char>(rng());
+        for (const auto &t_field : program.filters())
+        {
+            for (uint16_t j = 0; j < t_field.length; j++)
+            {
+                auto t_shift = t_field.endian == Endian::ED_Big ? (t_field.length - 1 - j) * 8 : j * 8;
+                t_packet[t_field.offset + j] = static_cast<char>(t_field.value >> t_shift);
+            }
+        }
+        if (i % 2)
+            t_packet[rng() % 34] ^= 0x5A;
+    }
+
+    BenchReport report("parser", argc, argv);
+    const int rounds = std::stoi(report.arg(0, "50"));
+    size_t jsonMatched = 0, compiledMatched = 0;
+    auto jsonNs = nsPerPacket(packets, rounds, [&](const std::string &t_packet)
+                              { return jsonWalkFilter(rule, t_packet); }, jsonMatched);
+    auto compiledNs = nsPerPacket(packets, rounds, [&](const std::string &t_packet)
+                                  { return program.match(reinterpret_cast<const uint8_t *>(t_packet.data()), t_packet.size()); }, compiledMatched);
+
+    // 批量过滤：整批按条件逐个执行，比较走 SIMD
+    std::vector<PacketView> views;
+    for (const auto &t_packet : packets)
+        views.emplace_back(t_packet);
+    std::vector<uint8_t> batchMatched(views.size());
+    size_t batchCount = 0;
+    auto batchBegin = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        program.matchBatch(views.data(), views.size(), batchMatched.data());
+        for (auto t_matched : batchMatched)
+            batchCount += t_matched;
+    }
+    auto batchNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - batchBegin).count() / (double(rounds) * packetCount);
+
+    if (jsonMatched != compiledMatched || batchCount != compiledMatched)
+    {
+        std::cerr << "结果不一致: json=" << jsonMatched << " compiled=" << compiledMatched << " batch=" << batchCount << std::endl;
+        return 1;
+    }
+    report.add("filter_json_walk", jsonNs, "ns/packet");
+    report.add("filter_compiled", compiledNs, "ns/packet");
+    report.add("filter_batch", batchNs, "ns/packet");
+
+    // 分类：300 种消息，分别用紧凑ID（跳转表）与稀疏ID（散列表），与逐条比较对比
+    for (bool sparse : {false, true})
+    {
+        json classifyRule;
+        classifyRule["classify"]["fields"] = json::array({{{"offset", 4}, {"length", 4}}});
+        classifyRule["messages"] = json::array();
+        std::vector<uint32_t> ids;
+        for (uint32_t i = 0; i < 300; i++)
+        {
+            ids.push_back(sparse ? static_cast<uint32_t>(rng()) : i + 100);
+            classifyRule["messages"].push_back({{"name", "msg" + std::to_string(i)}, {"id", ids.back()}});
+        }
+        ClassifyIndex index(classifyRule);
+        for (auto &t_packet : packets)
+        {
+            auto t_id = ids[rng() % ids.size()];
+            for (int j = 0; j < 4; j++)
+                t_packet[4 + j] = static_cast<char>(t_id >> (24 - j * 8));
+        }
+        size_t indexHits = 0, linearHits = 0;
+        auto indexNs = nsPerPacket(packets, rounds, [&](const std::string &t_packet)
+                                   { return index.classify(reinterpret_cast<const uint8_t *>(t_packet.data()), t_packet.size()) >= 0; }, indexHits);
+        auto linearNs = nsPerPacket(packets, rounds, [&](const std::string &t_packet)
+                                    {
+            auto t_key = index.keyOf(reinterpret_cast<const uint8_t *>(t_packet.data()));
+            for (const auto &t_message : index.messages())
+                if (t_message.key == t_key)
+                    return true;
+            return false; }, linearHits);
+        if (indexHits != linearHits)
+        {
+            std::cerr << "分类结果不一致: index=" << indexHits << " linear=" << linearHits << std::endl;
+            return 1;
+        }
+        report.add(index.isDense() ? "classify_jump_table" : "classify_hash_table", indexNs, "ns/packet");
+        report.add(index.isDense() ? "classify_dense_linear_scan" : "classify_sparse_linear_scan", linearNs, "ns/packet");
+    }
+
+    // 完整解析（过滤+分类+解码+回调）：解释执行规则 与 构建时由同一规则生成的静态解码器 对比
+    std::ifstream decodeRuleFile(BENCH_DECODE_RULE);
+    auto decodeRule = json::parse(decodeRuleFile);
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        auto &t_packet = packets[i];
+        for (auto &t_byte : t_packet)
+            t_byte = static_cast<char>(rng());
+        t_packet[0] = static_cast<char>(0xAA);
+        t_packet[1] = 0x55;
+        t_packet[2] = static_cast<char>(1 + rng() % 4); // 4 不满足过滤
+        t_packet[3] = static_cast<char>(1 + rng() % 3); // 3 归入 default
+        t_packet[12] = static_cast<char>(0xC0);
+        t_packet[13] = static_cast<char>(i % 8 ? 0xDE : 0x00);
+    }
+    auto decodeBench = [&](ProtocolParser &parser, uint64_t &checksum, size_t &results)
+    {
+        checksum = 0;
+        results = 0;
+        parser.addResultCallback([&](const ParseResult &result)
+                                 {
+            results++;
+            checksum += result.messageIndex;
+            for (size_t j = 0; j < result.fieldCount; j++)
+                checksum = checksum * 31 + result.fields[j].u + result.fields[j].bytes.size(); });
+        auto begin = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+            parser.parseBatch(views.data(), views.size());
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / (double(rounds) * packetCount);
+    };
+    JsonProtocolParser interpreted(decodeRule);
+    BenchDecoder generated;
+    uint64_t interpretedSum = 0, generatedSum = 0;
+    size_t interpretedResults = 0, generatedResults = 0;
+    auto interpretedNs = decodeBench(interpreted, interpretedSum, interpretedResults);
+    auto generatedNs = decodeBench(generated, generatedSum, generatedResults);
+    if (interpretedSum != generatedSum || interpretedResults != generatedResults)
+    {
+        std::cerr << "解码结果不一致: interpreted=" << interpretedResults << " generated=" << generatedResults << std::endl;
+        return 1;
+    }
+    report.add("parse_interpreted", interpretedNs, "ns/packet");
+    report.add("parse_generated", generatedNs, "ns/packet");
+    return 0;
+}
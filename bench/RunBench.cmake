@@ -0,0 +1,24 @@
+# 由 bench 目标调用：依次以 --json 运行 BENCH_SUITE（逗号分隔）中的基准程序，
+# 只保留以 { 开头的结果行，汇总写入 RESULT_FILE
+string(REPLACE "," ";" BENCH_SUITE "${BENCH_SUITE}")
+file(WRITE ${RESULT_FILE} "")
+foreach(PROGRAM ${BENCH_SUITE})
+    message(STATUS "Running ${PROGRAM}")
+    execute_process(
+        COMMAND ${BENCH_DIR}/${PROGRAM} --json
+        OUTPUT_VARIABLE BENCH_OUTPUT
+        RESULT_VARIABLE BENCH_RESULT
+    )
+    if(NOT BENCH_RESULT EQUAL 0)
+        message(FATAL_ERROR "${PROGRAM} failed: ${BENCH_RESULT}")
+    endif()
+    string(REPLACE ";" "\;" BENCH_OUTPUT "${BENCH_OUTPUT}")
+    string(REPLACE "\n" ";" BENCH_LINES "${BENCH_OUTPUT}")
+    foreach(LINE ${BENCH_LINES})
+        if(LINE MATCHES "^{")
+            message("${LINE}")
+            file(APPEND ${RESULT_FILE} "${LINE}\n")
+        endif()
+    endforeach()
+endforeach()
+message(STATUS "Benchmark results: ${RESULT_FILE}")
@@ -7,9 +7,18 @@
 #include <atomic>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <memory>
 #include <functional>
+#include <nlohmann/json.hpp>
 ///////////////////////////////基类与各种枚举////////////////////////////////
 
+class ObserverBase;
+class StateChangeEvent;
+
 /// @brief 主题容器基类
 class SubjectBase
 {
@@ -40,6 +49,17 @@ enum class StateType
     ST_Completed,    ///< 完成状态
 };
 
+/// @brief 订阅的状态集合，每个 StateType 占一位
+using StateMask = uint32_t;
+constexpr StateMask stateMaskAll = ~StateMask(0); ///< 订阅全部状态
+
+/// @brief 由一个或多个状态类型组成订阅集合，如 stateMask(StateType::ST_Update, StateType::ST_Error)
+template <typename... Types>
+constexpr StateMask stateMask(StateType type, Types... types)
+{
+    return (StateMask(1) << static_cast<int>(type)) | (StateMask(0) | ... | (StateMask(1) << static_cast<int>(types)));
+}
+
 /// @brief 观察者状态事件对象，包含状态类型、状态码和附加信息
 class StateChangeEvent
 {
@@ -49,7 +69,7 @@ public:
     /// @param stateCode 状态码，默认值为 0
     /// @param message 附加的消息，默认值为空字符串
     StateChangeEvent(StateType type, int stateCode = 0, const std::string &message = "")
-        : mType(type), mStateCode(stateCode), mMessage(message) {}
+        : mType(type), mStateCode(stateCode), mMessage(message.empty() ? nullptr : std::make_shared<const std::string>(message)) {}
 
     /// @brief 获取状态类型
     /// @return 返回状态类型
@@ -61,12 +81,16 @@ public:
 
     /// @brief 获取消息
     /// @return 返回消息
-    const std::string &getMessage() const { return mMessage; }
+    const std::string &getMessage() const
+    {
+        static const std::string empty;
+        return mMessage ? *mMessage : empty;
+    }
 
 private:
-    StateType mType;      ///< 状态类型
-    int mStateCode;       ///< 状态码（可选）
-    std::string mMessage; ///< 附带的消息（可选）
+    StateType mType;                            ///< 状态类型
+    int mStateCode;                             ///< 状态码（可选）
+    std::shared_ptr<const std::string> mMessage; ///< 附带的消息（可选），事件拷贝与排队时共享同一份，无消息时不分配
 };
 
 /// @brief 观察者基类，定义状态改变的处理接口
@@ -81,22 +105,131 @@ public:
     virtual ~ObserverBase() = default;
 };
 
+/// @brief 以函数对象或 lambda 实现的观察者
+class FunctionObserver : public ObserverBase
+{
+public:
+    using Callback = std::function<void(const StateChangeEvent &event)>;
+    explicit FunctionObserver(Callback callback) : mCallback(std::move(callback)) {}
+    void stateChanged(const StateChangeEvent &event) override { mCallback(event); }
+
+private:
+    Callback mCallback;
+};
+
 ///////////////////////////////config相关实现类/////////////////////////////////
 /// @brief 配置检查器主题类
+/// 观察者按 StateMask 订阅，只收到订阅的状态；观察者列表写时复制，通知时不加锁遍历，回调中增删观察者是安全的。
+/// 默认在通知者线程上同步回调；setAsync(true) 后通知只入队，由主题自己的分发线程回调，
+/// 队列中尚未分发的相同 ST_Update（状态码与消息都相同）合并为一次。
+/// removeObserver 返回后不会再有线程回调被删除的观察者，之后即可销毁它；
+/// 但在本主题的回调中删除时不等待，其他线程上正在进行的通知仍可能回调它，此时不可立即销毁。
+/// 异步模式下不可在回调中销毁主题本身。
 class ConfigSubject : public SubjectBase
 {
 public:
-    void addObserver(ObserverBase *observer) override;                                    ///< 添加观察者
-    void removeObserver(ObserverBase *observer) override;                                 ///< 删除观察者
-    void notifyAllObservers(const StateChangeEvent &event) override;                      ///< 通知所有观察者
+    ConfigSubject() = default;
+    ~ConfigSubject() override;
+    ConfigSubject(const ConfigSubject &) = delete;
+    ConfigSubject &operator=(const ConfigSubject &) = delete;
+
+    void addObserver(ObserverBase *observer) override;                                    ///< 添加观察者，订阅全部状态
+    void addObserver(ObserverBase *observer, StateMask state_mask);                       ///< 添加观察者，只订阅 state_mask 中的状态
+    ObserverBase *subscribe(FunctionObserver::Callback callback, StateMask state_mask = stateMaskAll); ///< 添加 lambda 观察者，由主题持有，返回值可传给 removeObserver
+    void removeObserver(ObserverBase *observer) override;                                 ///< 删除观察者，等待正在回调它的通知返回
+    void notifyAllObservers(const StateChangeEvent &event) override;                      ///< 通知所有订阅了该状态的观察者
     void notifyObservers(ObserverBase *observer, const StateChangeEvent &event) override; ///< 通知单个观察者
+    void setAsync(bool async);                                                            ///< 切换异步分发，关闭时先分发完队列中的事件
+    void flush();                                                                         ///< 阻塞直到已入队的事件都已分发
+
+private:
+    struct Subscription
+    {
+        ObserverBase *observer;
+        StateMask stateMask;
+        std::shared_ptr<ObserverBase> owned; ///< subscribe 创建的观察者由主题持有
+    };
+    using SubscriptionList = std::vector<Subscription>;
+
+    std::shared_ptr<const SubscriptionList> subscriptions() const; ///< 当前观察者列表的快照
+    void publish(std::shared_ptr<const SubscriptionList> list);     ///< 替换观察者列表，需持有 mSubscriptionMutex
+    void dispatch(const StateChangeEvent &event);                   ///< 在当前线程上回调订阅者
+    void dispatchLoop();                                            ///< 分发线程主循环
+
+    mutable std::mutex mSubscriptionMutex;                                               ///< 保护 mSubscriptions 指针本身
+    std::shared_ptr<const SubscriptionList> mSubscriptions{std::make_shared<SubscriptionList>()}; ///< 写时复制的观察者列表
+    std::vector<std::weak_ptr<const SubscriptionList>> mRetired;                        ///< 被替换下来、可能仍在通知中使用的旧列表
+
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCond;
+    std::deque<StateChangeEvent> mEventQueue; ///< 待分发事件
+    size_t mDispatching{0};                   ///< 已出队但还在回调中的事件数
+    bool mAsync{false};
+    bool mStopDispatch{false};
+    std::thread mDispatchThread;
 };
 /// @brief 配置观察者类
 class configObserver : public ObserverBase
 {
 public:
     void stateChanged(const StateChangeEvent &event) override;
-    // void stateChanged(const std::function<void()>& func) override; 传入函数对象或lambda 也可以用模板实现，后续考虑升级
+    // 传入函数对象或lambda 见 FunctionObserver 与 ConfigSubject::subscribe
+};
+
+/// @brief 某个配置文件一次解析结果的不可变快照，发布后不再修改，读者可以长期持有
+struct ConfigSnapshot
+{
+    std::string path;       ///< 注册时的路径
+    uint64_t version{0};    ///< 从 1 开始，内容每变化一次加一
+    nlohmann::json content; ///< 解析后的内容
+};
+using ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+
+/// @brief 单个配置文件的发布点（read-copy-update）
+/// 重新加载时先构造完整的新快照再原子替换指针，不与读者互斥；旧快照在最后一个持有它的读者释放后回收。
+/// libstdc++ 的 atomic<shared_ptr> 内部加锁且每次 load 都修改共享的引用计数，逐包读取应使用 ConfigReader
+class ConfigSlot
+{
+public:
+    ConfigSnapshotPtr load() const { return mSnapshot.load(std::memory_order_acquire); } ///< 当前快照，未加载成功时为空
+    uint64_t version() const { return mVersion.load(std::memory_order_relaxed); }         ///< 当前快照版本，未加载成功时为 0，只读一个整数
+
+private:
+    friend class configManager;
+    void publish(ConfigSnapshotPtr snapshot)
+    {
+        auto version = snapshot ? snapshot->version : 0;
+        mSnapshot.store(std::move(snapshot), std::memory_order_release);
+        mVersion.store(version, std::memory_order_release); // 先发布快照再发布版本，看到新版本的读者 load 到的至少是该版本
+    }
+
+    std::atomic<ConfigSnapshotPtr> mSnapshot;
+    std::atomic<uint64_t> mVersion{0};
+};
+using ConfigSlotPtr = std::shared_ptr<const ConfigSlot>;
+
+/// @brief 热路径读者：缓存一份快照，get() 只读一次版本号，版本变化时才重新 load
+/// 读取不修改任何共享缓存行；每个线程各持有一个，非线程安全
+class ConfigReader
+{
+public:
+    explicit ConfigReader(ConfigSlotPtr slot) : mSlot(std::move(slot)) {}
+
+    /// @brief 当前快照，未加载成功时为空；指针在下一次 get() 之前有效
+    const ConfigSnapshot *get()
+    {
+        if (this->mSlot->version() != this->mVersion)
+        {
+            this->mCached = this->mSlot->load();
+            this->mVersion = this->mCached ? this->mCached->version : 0;
+        }
+        return this->mCached.get();
+    }
+
+private:
+    ConfigSlotPtr mSlot;
+    ConfigSnapshotPtr mCached; ///< 持有的快照，换版本时释放
+    uint64_t mVersion{0};
 };
 
 /// @brief 静态全局配置文件管理器，后续考虑单例模式
@@ -106,21 +239,39 @@ public:
     void addConfigFile(const std::string &configPath, configObserver *observer); ///< 加载配置文件,并添加观察者
     void watchConfig(const std::string &configPath);                             ///< 配置文件修改更新的监听器，修改时候通知所有观察者
     void removeConfig(const std::string &configPath);                            ///< 删除配置文件，同时删除对应的主题，清空所有观察者
-    void getConfig(const std::string &configPath);                               ///< 得到对应的配置文件内容
+    ConfigSnapshotPtr getConfig(const std::string &configPath);                  ///< 得到对应的配置文件当前快照，不存在返回空
+    ConfigSlotPtr getConfigSlot(const std::string &configPath);                  ///< 得到配置文件的发布点，热路径线程持有它无锁读取
+    void stopWatch();                                                            ///< 停止监听线程
     // 设计思路：
     // 1. addConfigFile 加载配置文件就向检查mConfigSubjectMap是否存在<文件路径，配置主题容器>，存在就将观察者加入配置主题容器，不存在就构造一个，并加入
     // 2. watchConfig 监听配置文件就向mConfigSubjectMap查询是否存在这个路径以及配置主题容器，如果有就以这个路径的文件，启动监听线程监听修改或删除，修改就通知所有观察者
+    //    所有文件共用一个 inotify 监听线程；监听的是文件所在目录，编辑器"写临时文件再改名"的保存方式也能捕获
+    //    同一文件的连续事件在 mDebounce 内合并为一次，只重新解析发生变化的文件，解析成功通知 ST_Update，失败通知 ST_Error
     // 3. removeConfig 就从mConfigSubjectMap中删除配置文件，同时删除对应的主题，清空所有观察者
-    // 4. getConfig 读取配置文件，直接从mConfigSubjectMap中读取，如果存在就返回，不存在就返回空
+    // 4. getConfig 读取配置文件，直接从mConfigSlotMap中读取，如果存在就返回，不存在就返回空
+    //    收发包线程应在启动时用 getConfigSlot 取得发布点并构造 ConfigReader，之后每包 get() 一次，既不查表也不加锁
     static configManager &instance();
 
 private:
     configManager() = default;                                ///< 禁止直接构造
+    ~configManager();
     configManager(const configManager &) = delete;            ///< 禁止拷贝构造
     configManager &operator=(const configManager &) = delete; ///< 禁止拷贝赋值
-    
+
+    bool loadConfig(const std::string &configPath, std::string &error); ///< 解析配置文件并发布新快照
+    void publishConfig(const std::string &configPath, nlohmann::json &&content); ///< 构造下一版本快照并原子替换，需持有 mMutex
+    void watchLoop();                                                  ///< 监听线程主循环
+    void reloadConfig(const std::string &configPath);                  ///< 防抖结束后重新解析并通知观察者
+
     std::thread *mWatchThread{nullptr};                       ///< 配置文件状态监听器线程对象
     std::atomic<bool> mStopThread{false};                     ///< 原子线程停止标志
     std::map<std::string, ConfigSubject> mConfigSubjectMap;   ///< 管理多个文件的配置主题
+    std::map<std::string, std::shared_ptr<ConfigSlot>> mConfigSlotMap; ///< 各配置文件最近一次解析成功的快照
+    std::recursive_mutex mMutex;                              ///< 保护上面的容器，观察者回调中可重入
+    int mInotifyFd{-1};                                       ///< inotify 实例
+    int mWakeFd{-1};                                          ///< eventfd，用于唤醒监听线程退出
+    std::map<int, std::string> mWatchDirMap;                  ///< inotify 监听描述符到目录
+    std::map<std::string, std::string> mWatchFileMap;         ///< 被监听文件的规范路径到注册时的路径
+    std::chrono::milliseconds mDebounce{200};                 ///< 合并连续修改事件的时间窗口
 };
 #endif
\ No newline at end of file
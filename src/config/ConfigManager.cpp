@@ -1 +1,288 @@
-#include "Config.hpp"
\ No newline at end of file
+#include "Config.hpp"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace
+{
+    // 解析配置文件，不修改管理器状态
+    bool parseConfig(const std::string &configPath, nlohmann::json &content, std::string &error)
+    {
+        std::ifstream file(configPath);
+        if (!file)
+        {
+            error = "无法打开配置文件: " + configPath;
+            return false;
+        }
+        content = nlohmann::json::parse(file, nullptr, false);
+        if (content.is_discarded())
+        {
+            error = "配置文件解析失败: " + configPath;
+            return false;
+        }
+        return true;
+    }
+
+    std::string normalPath(const std::string &configPath)
+    {
+        return std::filesystem::absolute(configPath).lexically_normal().string();
+    }
+}
+
+configManager &configManager::instance()
+{
+    static configManager manager;
+    return manager;
+}
+
+configManager::~configManager()
+{
+    this->stopWatch();
+}
+
+bool configManager::loadConfig(const std::string &configPath, std::string &error)
+{
+    nlohmann::json content;
+    if (!parseConfig(configPath, content, error))
+        return false;
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    this->publishConfig(configPath, std::move(content));
+    return true;
+}
+
+void configManager::publishConfig(const std::string &configPath, nlohmann::json &&content)
+{
+    auto &slot = this->mConfigSlotMap[configPath];
+    if (!slot)
+        slot = std::make_shared<ConfigSlot>();
+    auto snapshot = std::make_shared<ConfigSnapshot>();
+    snapshot->path = configPath;
+    snapshot->version = slot->version() + 1;
+    snapshot->content = std::move(content);
+    slot->publish(std::move(snapshot));
+}
+
+ConfigSnapshotPtr configManager::getConfig(const std::string &configPath)
+{
+    auto slot = this->getConfigSlot(configPath);
+    return slot ? slot->load() : nullptr;
+}
+
+ConfigSlotPtr configManager::getConfigSlot(const std::string &configPath)
+{
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    auto it = this->mConfigSlotMap.find(configPath);
+    return it != this->mConfigSlotMap.end() ? it->second : nullptr;
+}
+
+void configManager::addConfigFile(const std::string &configPath, configObserver *observer)
+{
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    auto &subject = this->mConfigSubjectMap[configPath];
+    if (observer)
+        subject.addObserver(observer);
+    auto slotIt = this->mConfigSlotMap.find(configPath);
+    if (slotIt != this->mConfigSlotMap.end() && slotIt->second->load())
+        return;
+    std::string error;
+    if (!this->loadConfig(configPath, error))
+        std::cerr << error << std::endl;
+}
+
+void configManager::watchConfig(const std::string &configPath)
+{
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    if (!this->mConfigSubjectMap.count(configPath))
+    {
+        std::cerr << "配置文件未注册, 无法监听: " << configPath << std::endl;
+        return;
+    }
+    if (this->mInotifyFd < 0)
+    {
+        this->mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        this->mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (this->mInotifyFd < 0 || this->mWakeFd < 0)
+        {
+            std::cerr << "创建 inotify 失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+            if (this->mInotifyFd >= 0)
+                close(this->mInotifyFd);
+            if (this->mWakeFd >= 0)
+                close(this->mWakeFd);
+            this->mInotifyFd = this->mWakeFd = -1;
+            return;
+        }
+    }
+
+    // 监听所在目录而不是文件本身：改名覆盖式保存会换掉文件的 inode
+    auto fullPath = normalPath(configPath);
+    auto dirPath = std::filesystem::path(fullPath).parent_path().string();
+    int wd = inotify_add_watch(this->mInotifyFd, dirPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+    if (wd < 0)
+    {
+        std::cerr << "监听目录失败: " << dirPath << ", errno: " << errno << " - " << strerror(errno) << std::endl;
+        return;
+    }
+    this->mWatchDirMap[wd] = dirPath; // 同一目录重复添加返回相同的 wd
+    this->mWatchFileMap[fullPath] = configPath;
+
+    if (!this->mWatchThread)
+    {
+        this->mStopThread = false;
+        this->mWatchThread = new std::thread(&configManager::watchLoop, this);
+    }
+}
+
+void configManager::removeConfig(const std::string &configPath)
+{
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    this->mConfigSubjectMap.erase(configPath);
+    this->mConfigSlotMap.erase(configPath); // 已取得发布点的读者仍可读到最后一版快照
+    for (auto it = this->mWatchFileMap.begin(); it != this->mWatchFileMap.end();)
+    {
+        if (it->second == configPath)
+            it = this->mWatchFileMap.erase(it);
+        else
+            ++it;
+    }
+    // 目录下已没有被监听的文件时移除该目录的监听
+    for (auto it = this->mWatchDirMap.begin(); it != this->mWatchDirMap.end();)
+    {
+        bool used = std::any_of(this->mWatchFileMap.begin(), this->mWatchFileMap.end(), [&](const auto &t_file)
+                                { return std::filesystem::path(t_file.first).parent_path() == it->second; });
+        if (!used)
+        {
+            inotify_rm_watch(this->mInotifyFd, it->first);
+            it = this->mWatchDirMap.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void configManager::stopWatch()
+{
+    std::thread *watchThread = nullptr;
+    {
+        std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+        std::swap(watchThread, this->mWatchThread);
+    }
+    if (watchThread)
+    {
+        this->mStopThread = true;
+        uint64_t one = 1;
+        write(this->mWakeFd, &one, sizeof(one));
+        watchThread->join();
+        delete watchThread;
+    }
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    if (this->mInotifyFd >= 0)
+        close(this->mInotifyFd);
+    if (this->mWakeFd >= 0)
+        close(this->mWakeFd);
+    this->mInotifyFd = this->mWakeFd = -1;
+    this->mWatchDirMap.clear();
+    this->mWatchFileMap.clear();
+}
+
+void configManager::watchLoop()
+{
+    using clock = std::chrono::steady_clock;
+    std::map<std::string, clock::time_point> pendingMap; ///< 等待防抖结束的文件及其截止时间
+    alignas(inotify_event) char buffer[4096];
+
+    while (!this->mStopThread)
+    {
+        int timeout = -1;
+        if (!pendingMap.empty())
+        {
+            auto deadline = clock::time_point::max();
+            for (const auto &t_pending : pendingMap)
+                deadline = std::min(deadline, t_pending.second);
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+            timeout = static_cast<int>(std::max<int64_t>(wait, 0));
+        }
+
+        pollfd fds[2] = {{this->mInotifyFd, POLLIN, 0}, {this->mWakeFd, POLLIN, 0}};
+        if (poll(fds, 2, timeout) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "配置监听 poll 失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+            break;
+
+        if (fds[0].revents & POLLIN)
+        {
+            ssize_t length;
+            while ((length = read(this->mInotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+                auto deadline = clock::now() + this->mDebounce;
+                for (char *t_ptr = buffer; t_ptr < buffer + length;)
+                {
+                    auto *t_event = reinterpret_cast<inotify_event *>(t_ptr);
+                    t_ptr += sizeof(inotify_event) + t_event->len;
+                    if (t_event->mask & IN_Q_OVERFLOW)
+                    {
+                        // 事件队列溢出，无法确定哪些文件变化，全部重新解析
+                        for (const auto &t_file : this->mWatchFileMap)
+                            pendingMap[t_file.second] = deadline;
+                        continue;
+                    }
+                    auto dirIt = this->mWatchDirMap.find(t_event->wd);
+                    if (t_event->len == 0 || dirIt == this->mWatchDirMap.end())
+                        continue;
+                    auto fileIt = this->mWatchFileMap.find((std::filesystem::path(dirIt->second) / t_event->name).string());
+                    if (fileIt != this->mWatchFileMap.end())
+                        pendingMap[fileIt->second] = deadline; // 每个新事件都把截止时间往后推
+                }
+            }
+        }
+
+        auto now = clock::now();
+        for (auto it = pendingMap.begin(); it != pendingMap.end();)
+        {
+            if (it->second <= now)
+            {
+                this->reloadConfig(it->first);
+                it = pendingMap.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+}
+
+void configManager::reloadConfig(const std::string &configPath)
+{
+    nlohmann::json content;
+    std::string error;
+    bool parsed = parseConfig(configPath, content, error);
+
+    std::lock_guard<std::recursive_mutex> lock(this->mMutex);
+    auto subjectIt = this->mConfigSubjectMap.find(configPath);
+    if (subjectIt == this->mConfigSubjectMap.end())
+        return;
+    if (!parsed)
+    {
+        // 保留上一次解析成功的内容
+        subjectIt->second.notifyAllObservers(StateChangeEvent(StateType::ST_Error, 0, error));
+        return;
+    }
+    auto slotIt = this->mConfigSlotMap.find(configPath);
+    if (slotIt != this->mConfigSlotMap.end())
+    {
+        auto current = slotIt->second->load();
+        if (current && current->content == content)
+            return; // 只改了时间戳或格式，内容未变不通知
+    }
+    this->publishConfig(configPath, std::move(content));
+    subjectIt->second.notifyAllObservers(StateChangeEvent(StateType::ST_Update, 0, configPath));
+}
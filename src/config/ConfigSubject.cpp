@@ -1,32 +1,184 @@
 #include "Config.hpp"
 
+namespace
+{
+    // 当前线程上正在回调观察者的主题，回调中调用 removeObserver 时据此跳过等待
+    thread_local std::vector<const ConfigSubject *> tDispatchingSubjects;
+
+    struct DispatchScope
+    {
+        explicit DispatchScope(const ConfigSubject *subject) { tDispatchingSubjects.push_back(subject); }
+        ~DispatchScope() { tDispatchingSubjects.pop_back(); }
+    };
+}
+
+ConfigSubject::~ConfigSubject()
+{
+    this->setAsync(false);
+}
+
+std::shared_ptr<const ConfigSubject::SubscriptionList> ConfigSubject::subscriptions() const
+{
+    std::lock_guard<std::mutex> lock(this->mSubscriptionMutex);
+    return this->mSubscriptions;
+}
+
 void ConfigSubject::addObserver(ObserverBase *observer)
 {
-    this->mObserversContainer.push_back(observer);
+    this->addObserver(observer, stateMaskAll);
+}
+
+void ConfigSubject::addObserver(ObserverBase *observer, StateMask state_mask)
+{
+    if (!observer)
+        return;
+    std::lock_guard<std::mutex> lock(this->mSubscriptionMutex);
+    auto list = std::make_shared<SubscriptionList>(*this->mSubscriptions);
+    list->push_back({observer, state_mask, nullptr});
+    this->publish(std::move(list));
+}
+
+ObserverBase *ConfigSubject::subscribe(FunctionObserver::Callback callback, StateMask state_mask)
+{
+    auto observer = std::make_shared<FunctionObserver>(std::move(callback));
+    std::lock_guard<std::mutex> lock(this->mSubscriptionMutex);
+    auto list = std::make_shared<SubscriptionList>(*this->mSubscriptions);
+    list->push_back({observer.get(), state_mask, observer});
+    this->publish(std::move(list));
+    return observer.get();
+}
+
+void ConfigSubject::publish(std::shared_ptr<const SubscriptionList> list)
+{
+    // 旧列表可能仍被其他线程上的通知持有，记下来供 removeObserver 等待
+    this->mRetired.erase(std::remove_if(this->mRetired.begin(), this->mRetired.end(), [](const auto &t_list)
+                                        { return t_list.expired(); }),
+                         this->mRetired.end());
+    this->mRetired.push_back(this->mSubscriptions);
+    this->mSubscriptions = std::move(list);
 }
 
 void ConfigSubject::removeObserver(ObserverBase *observer)
 {
-    auto it = std::remove(this->mObserversContainer.begin(), this->mObserversContainer.end(), observer);
-    this->mObserversContainer.erase(it, this->mObserversContainer.end());
+    {
+        std::lock_guard<std::mutex> lock(this->mSubscriptionMutex);
+        auto list = std::make_shared<SubscriptionList>(*this->mSubscriptions);
+        auto it = std::remove_if(list->begin(), list->end(), [observer](const Subscription &t_sub)
+                                 { return t_sub.observer == observer; });
+        list->erase(it, list->end());
+        this->publish(std::move(list));
+    }
+    // 在本主题的回调中删除时不能等待（当前线程自己就持有旧列表）
+    if (std::find(tDispatchingSubjects.begin(), tDispatchingSubjects.end(), this) != tDispatchingSubjects.end())
+        return;
+    // 等待持有旧列表的通知全部返回，此后不会再有线程回调被删除的观察者；新开始的通知只会拿到新列表
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mSubscriptionMutex);
+            if (std::all_of(this->mRetired.begin(), this->mRetired.end(), [](const auto &t_list)
+                            { return t_list.expired(); }))
+                return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
 }
 
 void ConfigSubject::notifyObservers(ObserverBase *observer, const StateChangeEvent &event)
 {
     // 查询观察者是否存在
-    if (std::find(mObserversContainer.begin(), mObserversContainer.end(), observer) != mObserversContainer.end())
+    DispatchScope scope(this);
+    auto list = this->subscriptions();
+    for (const auto &t_sub : *list)
     {
-        observer->stateChanged(event); // 通知单个观察者
+        if (t_sub.observer == observer)
+        {
+            observer->stateChanged(event); // 通知单个观察者
+            return;
+        }
     }
 }
 
 void ConfigSubject::notifyAllObservers(const StateChangeEvent &event)
 {
-    for (auto observer : mObserversContainer)
     {
-        if (observer)
+        std::lock_guard<std::mutex> lock(this->mQueueMutex);
+        if (this->mAsync && !this->mStopDispatch)
+        {
+            // 队列中已有相同的更新事件时不再重复入队，观察者处理时读到的总是最新内容
+            bool merged = event.getType() == StateType::ST_Update &&
+                          std::any_of(this->mEventQueue.begin(), this->mEventQueue.end(), [&](const StateChangeEvent &t_event)
+                                      { return t_event.getType() == StateType::ST_Update && t_event.getCode() == event.getCode() &&
+                                               t_event.getMessage() == event.getMessage(); });
+            if (!merged)
+            {
+                this->mEventQueue.push_back(event);
+                this->mQueueCond.notify_all();
+            }
+            return;
+        }
+    }
+    this->dispatch(event);
+}
+
+void ConfigSubject::dispatch(const StateChangeEvent &event)
+{
+    auto bit = stateMask(event.getType());
+    DispatchScope scope(this);
+    auto list = this->subscriptions(); // 回调中增删观察者只影响下一次通知
+    for (const auto &t_sub : *list)
+    {
+        if (t_sub.stateMask & bit)
         {
-            observer->stateChanged(event); // 通知每个观察者
+            t_sub.observer->stateChanged(event); // 通知每个观察者
         }
     }
 }
+
+void ConfigSubject::setAsync(bool async)
+{
+    std::unique_lock<std::mutex> lock(this->mQueueMutex);
+    if (async == this->mAsync)
+        return;
+    if (async)
+    {
+        this->mAsync = true;
+        this->mStopDispatch = false;
+        this->mDispatchThread = std::thread(&ConfigSubject::dispatchLoop, this);
+        return;
+    }
+    // 分发线程取空队列后退出，此后的通知回到同步模式
+    this->mStopDispatch = true;
+    this->mQueueCond.notify_all();
+    lock.unlock();
+    this->mDispatchThread.join();
+    lock.lock();
+    this->mAsync = false;
+}
+
+void ConfigSubject::flush()
+{
+    std::unique_lock<std::mutex> lock(this->mQueueMutex);
+    this->mQueueCond.wait(lock, [this]
+                          { return this->mEventQueue.empty() && this->mDispatching == 0; });
+}
+
+void ConfigSubject::dispatchLoop()
+{
+    std::unique_lock<std::mutex> lock(this->mQueueMutex);
+    while (true)
+    {
+        this->mQueueCond.wait(lock, [this]
+                              { return !this->mEventQueue.empty() || this->mStopDispatch; });
+        if (this->mEventQueue.empty())
+            break;
+        auto event = std::move(this->mEventQueue.front());
+        this->mEventQueue.pop_front();
+        this->mDispatching++;
+        lock.unlock();
+        this->dispatch(event);
+        lock.lock();
+        this->mDispatching--;
+        this->mQueueCond.notify_all();
+    }
+}
@@ -0,0 +1,227 @@
+// 二进制日志离线解码工具：LogDecode <日志.bin> [输出文件]
+// 读取 LOG_BIN_* 写出的二进制日志，按格式串定义还原为与文本日志相同格式的行
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include "LogTool.hpp"
+
+namespace
+{
+    struct FormatDef
+    {
+        std::string file;
+        uint32_t line = 0;
+        std::string format;
+    };
+
+    template <typename T>
+    bool readValue(const std::string &data, size_t &pos, T &value)
+    {
+        if (pos + sizeof(T) > data.size())
+            return false;
+        std::memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool readCString(const std::string &data, size_t &pos, std::string &value)
+    {
+        auto end = data.find('\0', pos);
+        if (end == std::string::npos)
+            return false;
+        value.assign(data, pos, end - pos);
+        pos = end + 1;
+        return true;
+    }
+
+    // 解码一个参数，格式见 LogTool::encodeArg
+    bool decodeArg(const std::string &data, size_t &pos, std::string &text)
+    {
+        char tag;
+        if (!readValue(data, pos, tag))
+            return false;
+        switch (tag)
+        {
+        case 'b':
+        {
+            uint8_t val;
+            if (!readValue(data, pos, val))
+                return false;
+            text = val ? "true" : "false";
+            return true;
+        }
+        case 'c':
+        {
+            char val;
+            if (!readValue(data, pos, val))
+                return false;
+            text.assign(1, val);
+            return true;
+        }
+        case 'i':
+        {
+            int64_t val;
+            if (!readValue(data, pos, val))
+                return false;
+            text = std::to_string(val);
+            return true;
+        }
+        case 'u':
+        {
+            uint64_t val;
+            if (!readValue(data, pos, val))
+                return false;
+            text = std::to_string(val);
+            return true;
+        }
+        case 'f':
+        {
+            double val;
+            if (!readValue(data, pos, val))
+                return false;
+            std::ostringstream out;
+            out << val;
+            text = out.str();
+            return true;
+        }
+        case 's':
+        {
+            uint32_t length;
+            if (!readValue(data, pos, length) || pos + length > data.size())
+                return false;
+            text.assign(data, pos, length);
+            pos += length;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    std::string timeText(int64_t ns)
+    {
+        time_t seconds = static_cast<time_t>(ns / 1000000000);
+        std::tm timeinfo;
+        localtime_r(&seconds, &timeinfo);
+        char buffer[80];
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+        char fraction[16];
+        snprintf(fraction, sizeof(fraction), ".%09lld", static_cast<long long>(ns % 1000000000));
+        return std::string(buffer) + fraction;
+    }
+
+    // 按格式串中的 {} 依次替换参数，多余的参数追加在行尾
+    std::string render(const FormatDef &def, const std::string &data, size_t pos, size_t end)
+    {
+        std::string result;
+        std::string arg;
+        std::string args(data, pos, end - pos);
+        size_t argPos = 0;
+        size_t start = 0;
+        while (true)
+        {
+            auto mark = def.format.find("{}", start);
+            if (mark == std::string::npos)
+                break;
+            result.append(def.format, start, mark - start);
+            if (argPos < args.size() && decodeArg(args, argPos, arg))
+                result += arg;
+            else
+                result += "{?}";
+            start = mark + 2;
+        }
+        result.append(def.format, start, std::string::npos);
+        while (argPos < args.size() && decodeArg(args, argPos, arg))
+            result += " " + arg;
+        return result;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <binary log> [output]" << std::endl;
+        return 1;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input)
+    {
+        std::cerr << "Unable to open " << argv[1] << std::endl;
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(LogTool::binaryMagic) || std::memcmp(data.data(), LogTool::binaryMagic, sizeof(LogTool::binaryMagic)) != 0)
+    {
+        std::cerr << argv[1] << " is not a binary log file" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (argc > 2)
+    {
+        file.open(argv[2]);
+        if (!file)
+        {
+            std::cerr << "Unable to open " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &output = argc > 2 ? file : std::cout;
+
+    // 数据记录可能先于其格式串定义写出，因此先收集全部定义。
+    // 格式串ID每个进程从 1 开始，多次运行追加在同一文件中，定义按会话（会话记录之后直到下一条会话记录）区分；
+    // 没有会话记录的旧文件全部归入会话 0
+    std::map<std::pair<uint64_t, uint32_t>, FormatDef> formats;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        uint64_t session = 0;
+        size_t pos = sizeof(LogTool::binaryMagic);
+        while (pos < data.size())
+        {
+            uint32_t length;
+            uint8_t kind, level;
+            if (!readValue(data, pos, length) || !readValue(data, pos, kind) || !readValue(data, pos, level) ||
+                pos + length > data.size())
+            {
+                if (pass == 1)
+                    std::cerr << "truncated record at offset " << pos << std::endl;
+                break;
+            }
+            auto end = pos + length;
+            uint32_t id;
+            if (kind == LogTool::brk_session)
+            {
+                readValue(data, pos, session);
+            }
+            else if (kind == LogTool::brk_format && pass == 0)
+            {
+                FormatDef def;
+                if (readValue(data, pos, id) && readValue(data, pos, def.line) &&
+                    readCString(data, pos, def.file) && readCString(data, pos, def.format))
+                    formats[{session, id}] = std::move(def);
+            }
+            else if (kind == LogTool::brk_data && pass == 1)
+            {
+                int64_t ns;
+                if (readValue(data, pos, id) && readValue(data, pos, ns))
+                {
+                    output << timeText(ns) << " [" << LogTool::levelName(level) << "] ";
+                    auto it = formats.find({session, id});
+                    if (it != formats.end())
+                        output << render(it->second, data, pos, end) << " (" << it->second.file << ":" << it->second.line << ")\n";
+                    else
+                        output << "<unknown format " << id << ">\n";
+                }
+            }
+            pos = end;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,555 @@
+#include "LogTool.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// 单例实例初始化
+std::unique_ptr<LogTool> LogTool::instance;
+std::once_flag LogTool::initInstanceFlag;
+
+namespace
+{
+    constexpr size_t alignCacheLine = 64;
+    void appendBinaryRecord(std::string &out, LogTool::BinaryRecordKind kind, uint8_t level, const char *payload, size_t length)
+    {
+        uint32_t payloadLength = static_cast<uint32_t>(length);
+        out.append(reinterpret_cast<const char *>(&payloadLength), sizeof(payloadLength));
+        out.push_back(static_cast<char>(kind));
+        out.push_back(static_cast<char>(level));
+        out.append(payload, length);
+    }
+
+    // 环形缓冲区中的日志记录头，文本紧随其后
+    struct RecordHeader
+    {
+        uint32_t length;
+        uint8_t level;
+        uint8_t target;
+        int64_t seconds; ///< 提交时刻的秒级时间戳
+    };
+
+    // 单个线程独占的 SPSC 字节环：该线程写，后台线程读
+    class ThreadBuffer
+    {
+    public:
+        static constexpr size_t capacity = 1 << 18; ///< 256KB，写满时丢弃新日志
+
+        bool push(const RecordHeader &header, const char *text)
+        {
+            auto need = sizeof(header) + header.length;
+            auto tail = this->tail.load(std::memory_order_relaxed);
+            if (need > capacity - (tail - this->head.load(std::memory_order_acquire)))
+            {
+                this->dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            this->copyIn(tail, &header, sizeof(header));
+            this->copyIn(tail + sizeof(header), text, header.length);
+            this->tail.store(tail + need, std::memory_order_release);
+            return true;
+        }
+
+        // 取出所有已提交的记录
+        template <typename Func>
+        size_t drain(Func &&func, std::string &scratch)
+        {
+            size_t count = 0;
+            auto head = this->head.load(std::memory_order_relaxed);
+            auto tail = this->tail.load(std::memory_order_acquire);
+            while (head < tail)
+            {
+                RecordHeader header;
+                this->copyOut(head, &header, sizeof(header));
+                scratch.resize(header.length);
+                this->copyOut(head + sizeof(header), scratch.data(), header.length);
+                head += sizeof(header) + header.length;
+                func(header, scratch);
+                count++;
+            }
+            this->head.store(head, std::memory_order_release);
+            return count;
+        }
+
+        uint64_t takeDropped() { return this->dropped.exchange(0, std::memory_order_relaxed); }
+
+        std::atomic<bool> retired{false}; ///< 所属线程已退出
+
+    private:
+        void copyIn(uint64_t pos, const void *src, size_t length)
+        {
+            auto offset = pos & (capacity - 1);
+            auto first = std::min(length, capacity - offset);
+            std::memcpy(this->ring.data() + offset, src, first);
+            std::memcpy(this->ring.data(), static_cast<const char *>(src) + first, length - first);
+        }
+        void copyOut(uint64_t pos, void *dst, size_t length) const
+        {
+            auto offset = pos & (capacity - 1);
+            auto first = std::min(length, capacity - offset);
+            std::memcpy(dst, this->ring.data() + offset, first);
+            std::memcpy(static_cast<char *>(dst) + first, this->ring.data(), length - first);
+        }
+
+        std::vector<char> ring = std::vector<char>(capacity);
+        alignas(alignCacheLine) std::atomic<uint64_t> head{0};
+        alignas(alignCacheLine) std::atomic<uint64_t> tail{0};
+        alignas(alignCacheLine) std::atomic<uint64_t> dropped{0};
+    };
+}
+
+/// @brief 后台写日志线程及其状态
+class LogTool::Backend
+{
+public:
+    Backend()
+    {
+        // 格式串ID每个进程从 1 开始，同一文件中多次运行的记录靠会话ID区分
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        this->sessionId = static_cast<uint64_t>(ns) ^ (static_cast<uint64_t>(getpid()) << 40);
+        this->writeThread = std::thread(&Backend::run, this);
+    }
+
+    ~Backend()
+    {
+        this->running = false;
+        if (this->writeThread.joinable())
+            this->writeThread.join();
+        std::lock_guard<std::mutex> lock(this->fileMutex);
+        this->closeFile();
+        this->closeBinary();
+    }
+
+    // 当前线程的缓冲区，首次使用时注册
+    ThreadBuffer &threadBuffer()
+    {
+        struct Holder
+        {
+            std::shared_ptr<ThreadBuffer> buffer;
+            ~Holder()
+            {
+                if (buffer)
+                    buffer->retired = true;
+            }
+        };
+        thread_local Holder holder;
+        if (!holder.buffer)
+        {
+            holder.buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(this->bufferMutex);
+            this->buffers.push_back(holder.buffer);
+        }
+        return *holder.buffer;
+    }
+
+    void setLogFile(const std::string &path, size_t max_file_size, int max_files)
+    {
+        this->flush();
+        std::lock_guard<std::mutex> lock(this->fileMutex);
+        this->closeFile();
+        this->filePath = path;
+        this->maxFileSize = max_file_size;
+        this->maxFiles = max_files;
+        if (!this->binaryPathSet)
+        {
+            this->closeBinary();
+            this->binaryPath = path + ".bin";
+        }
+    }
+
+    void setBinaryFile(const std::string &path)
+    {
+        this->flush();
+        std::lock_guard<std::mutex> lock(this->fileMutex);
+        this->closeBinary();
+        this->binaryPath = path;
+        this->binaryPathSet = true;
+    }
+
+    void clearLog()
+    {
+        this->flush();
+        std::lock_guard<std::mutex> lock(this->fileMutex);
+        this->closeFile();
+        if (std::remove(this->filePath.c_str()) != 0)
+            std::cerr << "Failed to delete log file." << std::endl;
+        else
+            std::cout << "Log file deleted successfully." << std::endl;
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(this->flushMutex);
+        auto target = ++this->flushRequested;
+        this->flushCond.wait(lock, [&]
+                             { return this->flushDone >= target || !this->running; });
+    }
+
+    uint64_t droppedCount() const { return this->droppedTotal.load(std::memory_order_relaxed); }
+
+    /// 同步写出一条格式串定义：不经过可能丢弃记录的线程缓冲区，并保存下来写入之后打开的每个二进制文件
+    void writeFormat(uint8_t level, const std::string &payload)
+    {
+        std::string record;
+        appendBinaryRecord(record, LogTool::brk_format, level, payload.data(), payload.size());
+        std::lock_guard<std::mutex> lock(this->fileMutex);
+        this->formatRecords += record;
+        if (this->binaryFd >= 0)
+            writeAll(this->binaryFd, record);
+        else
+            this->openBinary(); // 打开时写入全部定义
+    }
+
+private:
+    void run()
+    {
+        std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+        int idleRounds = 0;
+        while (true)
+        {
+            bool stopping = !this->running.load();
+            uint64_t flushTarget;
+            {
+                std::lock_guard<std::mutex> lock(this->flushMutex);
+                flushTarget = this->flushRequested;
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->bufferMutex);
+                snapshot = this->buffers;
+            }
+
+            size_t count = 0;
+            uint64_t dropped = 0;
+            for (auto &t_buffer : snapshot)
+            {
+                count += t_buffer->drain([this](const RecordHeader &header, const std::string &text)
+                                         { this->format(header, text); }, this->scratch);
+                dropped += t_buffer->takeDropped();
+            }
+            if (dropped)
+            {
+                this->droppedTotal += dropped;
+                RecordHeader header{0, WARN, LT_File, static_cast<int64_t>(time(nullptr))};
+                this->format(header, std::to_string(dropped) + " log records dropped, thread buffer full");
+            }
+            this->writeOut();
+            this->reapRetired();
+
+            {
+                std::lock_guard<std::mutex> lock(this->flushMutex);
+                this->flushDone = flushTarget;
+            }
+            this->flushCond.notify_all();
+
+            if (stopping)
+                break;
+            if (count > 0 || this->flushRequested.load() != flushTarget)
+            {
+                idleRounds = 0;
+                continue;
+            }
+            // 空闲时逐步拉长休眠，最长 10ms，日志延迟以此为上界
+            idleRounds = std::min(idleRounds + 1, 10);
+            std::this_thread::sleep_for(std::chrono::milliseconds(idleRounds));
+        }
+        std::lock_guard<std::mutex> lock(this->flushMutex);
+        this->flushDone = this->flushRequested;
+        this->flushCond.notify_all();
+    }
+
+    // 时间文本按秒缓存，同一秒内的日志不重复调用 localtime/strftime
+    const std::string &timeText(int64_t seconds)
+    {
+        if (seconds != this->cachedSecond)
+        {
+            time_t ts = static_cast<time_t>(seconds);
+            std::tm timeinfo;
+            localtime_r(&ts, &timeinfo);
+            char buffer[80];
+            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+            this->cachedTime = buffer;
+            this->cachedSecond = seconds;
+        }
+        return this->cachedTime;
+    }
+
+    void format(const RecordHeader &header, const std::string &text)
+    {
+        if (header.target == LT_Binary)
+        {
+            appendBinaryRecord(this->binaryBatch, LogTool::brk_data, header.level, text.data(), text.size());
+            return;
+        }
+        auto &batch = header.target == LT_Console ? this->consoleBatch : this->fileBatch;
+        batch += this->timeText(header.seconds);
+        batch += " [";
+        batch += LogTool::levelName(header.level);
+        batch += "] ";
+        batch += text;
+        batch += '\n';
+    }
+
+    void writeOut()
+    {
+        if (!this->consoleBatch.empty())
+        {
+            fwrite(this->consoleBatch.data(), 1, this->consoleBatch.size(), stdout);
+            fflush(stdout);
+            this->consoleBatch.clear();
+        }
+        if (this->fileBatch.empty() && this->binaryBatch.empty())
+            return;
+        std::lock_guard<std::mutex> lock(this->fileMutex);
+        this->writeBinary();
+        if (this->fileBatch.empty())
+            return;
+        if (this->fileFd < 0 && !this->openFile())
+        {
+            this->fileBatch.clear();
+            return;
+        }
+        size_t written = 0;
+        while (written < this->fileBatch.size())
+        {
+            auto res = ::write(this->fileFd, this->fileBatch.data() + written, this->fileBatch.size() - written);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            written += res;
+        }
+        this->fileSize += written;
+        this->fileBatch.clear();
+        if (this->maxFileSize > 0 && this->fileSize >= this->maxFileSize)
+            this->rotate();
+    }
+
+    static void writeAll(int fd, const std::string &data)
+    {
+        size_t written = 0;
+        while (written < data.size())
+        {
+            auto res = ::write(fd, data.data() + written, data.size() - written);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            written += res;
+        }
+    }
+
+    void writeBinary()
+    {
+        if (this->binaryBatch.empty())
+            return;
+        if (this->binaryFd < 0 && !this->openBinary())
+        {
+            this->binaryBatch.clear();
+            return;
+        }
+        writeAll(this->binaryFd, this->binaryBatch);
+        this->binaryBatch.clear();
+    }
+
+    // 打开（追加）二进制文件：新文件先写文件头，之后写本进程的会话记录与已登记的全部格式串定义，需持有 fileMutex
+    bool openBinary()
+    {
+        this->binaryFd = ::open(this->binaryPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (this->binaryFd < 0)
+        {
+            std::cerr << "Unable to open binary log file for writing" << std::endl;
+            return false;
+        }
+        std::string head;
+        if (lseek(this->binaryFd, 0, SEEK_END) == 0)
+            head.assign(LogTool::binaryMagic, sizeof(LogTool::binaryMagic));
+        appendBinaryRecord(head, LogTool::brk_session, MSG, reinterpret_cast<const char *>(&this->sessionId), sizeof(this->sessionId));
+        head += this->formatRecords;
+        writeAll(this->binaryFd, head);
+        return true;
+    }
+
+    bool openFile()
+    {
+        this->fileFd = ::open(this->filePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (this->fileFd < 0)
+        {
+            std::cerr << "Unable to open file for writing" << std::endl;
+            return false;
+        }
+        this->fileSize = static_cast<size_t>(lseek(this->fileFd, 0, SEEK_END));
+        std::string banner = "-- Start Log: " + this->timeText(time(nullptr)) + " --\n";
+        ::write(this->fileFd, banner.data(), banner.size());
+        this->fileSize += banner.size();
+        return true;
+    }
+
+    void closeFile()
+    {
+        if (this->fileFd >= 0)
+            ::close(this->fileFd);
+        this->fileFd = -1;
+    }
+
+    void closeBinary()
+    {
+        if (this->binaryFd >= 0)
+            ::close(this->binaryFd);
+        this->binaryFd = -1;
+    }
+
+    // path.N-1 -> path.N ... path -> path.1，下次写入时重新打开
+    void rotate()
+    {
+        this->closeFile();
+        for (int i = this->maxFiles - 1; i >= 1; i--)
+            std::rename((this->filePath + "." + std::to_string(i)).c_str(), (this->filePath + "." + std::to_string(i + 1)).c_str());
+        if (this->maxFiles > 0)
+            std::rename(this->filePath.c_str(), (this->filePath + ".1").c_str());
+        else
+            std::remove(this->filePath.c_str());
+    }
+
+    void reapRetired()
+    {
+        std::lock_guard<std::mutex> lock(this->bufferMutex);
+        for (auto it = this->buffers.begin(); it != this->buffers.end();)
+        {
+            // 退出线程的缓冲区在最后一次取空后移除
+            if ((*it)->retired && it->use_count() == 1)
+                it = this->buffers.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::thread writeThread;
+    std::atomic<bool> running{true};
+
+    std::mutex bufferMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers; ///< 所有线程的缓冲区
+    std::string scratch;                                ///< 取出单条记录的临时空间
+    std::string consoleBatch;                           ///< 本轮待写到控制台的内容
+    std::string fileBatch;                              ///< 本轮待写到文件的内容
+    std::string binaryBatch;                            ///< 本轮待写到二进制文件的内容
+    std::atomic<uint64_t> droppedTotal{0};
+
+    int64_t cachedSecond = -1;
+    std::string cachedTime;
+
+    std::mutex fileMutex; ///< 保护文件句柄与路径，只在后台写出、清除与切换文件时使用
+    std::string filePath = logFilePath;
+    int fileFd = -1;
+    size_t fileSize = 0;
+    size_t maxFileSize = 0;
+    int maxFiles = 5;
+    std::string binaryPath = std::string(logFilePath) + ".bin";
+    bool binaryPathSet = false; ///< 是否单独指定过二进制文件路径
+    int binaryFd = -1;
+    uint64_t sessionId = 0;     ///< 本进程写入二进制文件的会话ID
+    std::string formatRecords;  ///< 本进程已登记的格式串定义记录，受 fileMutex 保护
+
+    std::mutex flushMutex;
+    std::condition_variable flushCond;
+    std::atomic<uint64_t> flushRequested{0};
+    uint64_t flushDone = 0;
+};
+
+LogTool &LogTool::getInstance()
+{
+    std::call_once(initInstanceFlag, []
+                   { instance.reset(new LogTool()); });
+    return *instance;
+}
+
+LogTool::LogTool() : backend(std::make_unique<Backend>())
+{
+}
+
+LogTool::~LogTool() = default;
+
+LogTool::LogLine &LogTool::threadLine()
+{
+    thread_local LogLine line;
+    return line;
+}
+
+void LogTool::commit(LogTarget target, LogLevel level, const char *text, size_t length)
+{
+    RecordHeader header{static_cast<uint32_t>(length), static_cast<uint8_t>(level), target, static_cast<int64_t>(time(nullptr))};
+    this->backend->threadBuffer().push(header, text);
+}
+
+uint32_t LogTool::registerFormat(LogLevel level, const char *file, int line, const char *format)
+{
+    // 格式串定义：4 字节ID + 4 字节行号 + 文件名\0 + 格式串\0，见 brk_format
+    uint32_t id = this->nextFormatId++;
+    uint32_t lineNo = static_cast<uint32_t>(line);
+    std::string payload;
+    payload.append(reinterpret_cast<const char *>(&id), sizeof(id));
+    payload.append(reinterpret_cast<const char *>(&lineNo), sizeof(lineNo));
+    payload.append(file).push_back('\0');
+    payload.append(format).push_back('\0');
+    this->backend->writeFormat(static_cast<uint8_t>(level), payload);
+    return id;
+}
+
+bool LogTool::setLevel(const std::string &level_name)
+{
+    std::string name = level_name;
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch)
+                   { return std::tolower(ch); });
+    if (name == "debug")
+        setLevel(DEBUG);
+    else if (name == "info")
+        setLevel(INFO);
+    else if (name == "warn" || name == "warning")
+        setLevel(WARN);
+    else if (name == "error")
+        setLevel(ERROR);
+    else
+        return false;
+    return true;
+}
+
+bool LogTool::applyConfig(const nlohmann::json &config)
+{
+    auto it = config.find("log_level");
+    if (it == config.end() || !it->is_string())
+        return false;
+    return setLevel(it->get<std::string>());
+}
+
+void LogTool::setBinaryFile(const std::string &path)
+{
+    this->backend->setBinaryFile(path);
+}
+
+void LogTool::clearLog()
+{
+    this->backend->clearLog();
+}
+
+void LogTool::setLogFile(const std::string &path, size_t max_file_size, int max_files)
+{
+    this->backend->setLogFile(path, max_file_size, max_files);
+}
+
+void LogTool::flush()
+{
+    this->backend->flush();
+}
+
+uint64_t LogTool::droppedCount() const
+{
+    return this->backend->droppedCount();
+}
@@ -1,12 +1,29 @@
+#ifndef _LogTool_hpp_
+#define _LogTool_hpp_
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <chrono>
 #include <ctime>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <nlohmann/json.hpp>
 
 constexpr auto logFilePath = "./1.txt";
 
+// 编译期最低日志级别，低于它的 LOG_* 语句连同参数求值一起被编译器消除
+// 取值 0 DEBUG、1 INFO、2 WARN、3 ERROR，可通过 -DLOG_COMPILE_LEVEL=N 覆盖
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+/// @brief 异步日志
+/// 调用线程只在线程局部的缓冲区里格式化一行，再写入本线程独占的无锁环形缓冲区后立即返回；
+/// 后台线程汇总所有线程的缓冲区，批量写入常开的日志文件（或控制台），并按大小滚动文件。
 class LogTool
 {
 public:
@@ -19,102 +36,268 @@ public:
         MSG
     };
 
-    // 获取单例实例
-    static LogTool &getInstance()
+    /// @brief 日志输出目标
+    enum LogTarget : uint8_t
+    {
+        LT_Console,      ///< 标准输出
+        LT_File,         ///< 日志文件
+        LT_Binary,       ///< 二进制日志文件中的数据记录
+        LT_BinaryFormat  ///< 二进制日志文件中的格式串定义，由 registerFormat 同步写出，不经过线程缓冲区
+    };
+
+    /// @brief 二进制日志文件头，写入端与 LogDecode 共用
+    static constexpr char binaryMagic[8] = {'P', 'T', 'L', 'O', 'G', 'B', 'I', 'N'};
+
+    /// @brief 二进制记录种类，记录格式：4 字节负载长度 + 1 字节种类 + 1 字节级别 + 负载
+    enum BinaryRecordKind : uint8_t
     {
-        return *instance;
+        brk_format = 0,  ///< 格式串定义：4 字节ID + 4 字节行号 + 文件名\0 + 格式串\0
+        brk_data = 1,    ///< 数据：4 字节格式串ID + 8 字节纳秒时间戳 + 参数
+        brk_session = 2  ///< 会话开始：8 字节会话ID，其后的格式串ID只在本会话内有效
+    };
+
+    /// @brief 级别在日志行中的名称
+    static constexpr const char *levelName(int level)
+    {
+        switch (level)
+        {
+        case INFO:
+            return "INFO";
+        case DEBUG:
+            return "DEBUG";
+        case WARN:
+            return "WARN";
+        case ERROR:
+            return "ERROR";
+        case MSG:
+            return "MSG";
+        default:
+            return "UNKNOWN";
+        }
     }
 
+    /// @brief 级别的严重程度，枚举值本身不按严重程度排列
+    static constexpr int levelRank(LogLevel level)
+    {
+        switch (level)
+        {
+        case DEBUG:
+            return 0;
+        case INFO:
+            return 1;
+        case WARN:
+            return 2;
+        case ERROR:
+            return 3;
+        default:
+            return 4; // MSG 始终输出
+        }
+    }
+
+    /// @brief 该级别是否编译进程序
+    static constexpr bool compiledIn(LogLevel level) { return levelRank(level) >= LOG_COMPILE_LEVEL; }
+
+    /// @brief 该级别在运行期是否开启，一次原子读
+    static bool enabled(LogLevel level) { return levelRank(level) >= runtimeLevel.load(std::memory_order_relaxed); }
+
+    static void setLevel(LogLevel level) { runtimeLevel.store(levelRank(level), std::memory_order_relaxed); }
+
+    /// @brief 按名称设置运行期级别，名称为 debug/info/warn/error（不区分大小写）
+    static bool setLevel(const std::string &level_name);
+
+    /// @brief 读取配置中的 log_level 设置运行期级别，缺少该键时不修改
+    static bool applyConfig(const nlohmann::json &config);
+
+    // 获取单例实例
+    static LogTool &getInstance();
+
     // 打印日志到控制台
     template <typename... Args>
     void printLog(LogLevel level, const Args &...args)
     {
-        std::cout << getTime() << " [" << levelToString(level) << "] ";
-        ((std::cout << args), ...);
-        std::cout << std::endl;
+        this->write(LT_Console, level, args...);
     }
 
     // 追加日志到文件
     template <typename... Args>
     void appendLog(LogLevel level, const Args &...args)
     {
-        std::ofstream file(logFilePath, std::ios::app);
-        if (file.is_open())
-        {
-            file << getTime() << " [" << levelToString(level) << "] ";
-            ((file << args), ...);
-            file << std::endl;
-        }
-        else
-        {
-            std::cerr << "Unable to open file for writing" << std::endl;
-        }
+        this->write(LT_File, level, args...);
     }
 
-    // 清除日志文件
-    void clearLog()
+    /// @brief 二进制日志：只记录格式串ID与原始参数，由 LogDecode 离线还原为文本
+    /// 支持整数、浮点、bool、char、枚举与字符串参数，格式串中的 {} 依次替换为参数
+    template <typename... Args>
+    void appendBinary(LogLevel level, uint32_t format_id, const Args &...args)
     {
-        if (std::remove(logFilePath) != 0)
-            std::cerr << "Failed to delete log file." << std::endl;
-        else
-            std::cout << "Log file deleted successfully." << std::endl;
+        auto &line = threadLine();
+        line.clear();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        line.appendRaw(&format_id, sizeof(format_id));
+        line.appendRaw(&ns, sizeof(ns));
+        (encodeArg(line, args), ...);
+        this->commit(LT_Binary, level, line.data(), line.size());
     }
 
-private:
-    LogTool()
+    /// @brief 登记一个二进制日志调用点的格式串，返回其ID；每个调用点只在首次执行时调用
+    /// 定义同步写入二进制文件（不会因线程缓冲区写满而丢失），ID 只在本进程的会话内有效
+    uint32_t registerFormat(LogLevel level, const char *file, int line, const char *format);
+
+    // 清除日志文件
+    void clearLog();
+
+    /// @brief 设置日志文件与滚动策略
+    /// @param path 日志文件路径
+    /// @param max_file_size 单个文件的最大字节数，超过后滚动为 path.1 ~ path.N，0 表示不滚动
+    /// @param max_files 保留的历史文件个数
+    void setLogFile(const std::string &path, size_t max_file_size = 0, int max_files = 5);
+
+    /// @brief 设置二进制日志文件路径，缺省为日志文件路径加 .bin；二进制文件不滚动，
+    /// 每次打开时写入会话记录与本进程已登记的全部格式串定义，多次运行追加到同一文件也能各自解码
+    void setBinaryFile(const std::string &path);
+
+    /// @brief 阻塞直到调用前提交的日志都已写出
+    void flush();
+
+    /// @brief 因线程缓冲区写满而丢弃的日志条数
+    uint64_t droppedCount() const;
+
+    ~LogTool();
+
+    /// @brief 线程局部的单行格式化缓冲区，复用内存，稳态下不分配
+    class LogLine : private std::streambuf
     {
-        std::ofstream file(logFilePath, std::ios::app);
-        if (file.is_open())
+    public:
+        LogLine() : stream(this) {}
+        std::ostream &out() { return stream; }
+        void clear() { text.clear(); }
+        const char *data() const { return text.data(); }
+        size_t size() const { return text.size(); }
+        void appendRaw(const void *bytes, size_t length) { text.append(static_cast<const char *>(bytes), length); }
+
+    private:
+        int_type overflow(int_type ch) override
         {
-            file << "-- Start Log: " << getTime() << " --" << std::endl;
+            if (ch != traits_type::eof())
+                text.push_back(static_cast<char>(ch));
+            return ch;
         }
-        else
+        std::streamsize xsputn(const char *s, std::streamsize n) override
         {
-            std::cerr << "Unable to open file" << std::endl;
+            text.append(s, n);
+            return n;
         }
-    }
 
-    // 时间格式化
-    std::string getTime() const
+        std::string text;
+        std::ostream stream;
+    };
+
+private:
+    LogTool();
+
+    template <typename... Args>
+    void write(LogTarget target, LogLevel level, const Args &...args)
     {
-        time_t ts = time(nullptr);
-        std::tm *timeinfo = std::localtime(&ts);
-        char buffer[80];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
-        return buffer;
+        auto &line = threadLine();
+        line.clear();
+        ((line.out() << args), ...);
+        this->commit(target, level, line.data(), line.size());
     }
 
-    // 日志级别转换
-    const char *levelToString(LogLevel level) const
+    // 二进制参数编码：1 字节类型标记 + 定长值，字符串为 4 字节长度 + 内容
+    template <typename T>
+    static void encodeArg(LogLine &line, const T &arg)
     {
-        switch (level)
+        if constexpr (std::is_same_v<T, bool>)
         {
-        case INFO:
-            return "INFO";
-        case DEBUG:
-            return "DEBUG";
-        case WARN:
-            return "WARN";
-        case ERROR:
-            return "ERROR";
-        case MSG:
-            return "MSG";
-        default:
-            return "UNKNOWN";
+            uint8_t val = arg ? 1 : 0;
+            line.appendRaw("b", 1);
+            line.appendRaw(&val, 1);
+        }
+        else if constexpr (std::is_same_v<T, char>)
+        {
+            line.appendRaw("c", 1);
+            line.appendRaw(&arg, 1);
+        }
+        else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+        {
+            using Raw = std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::type_identity<T>>;
+            if constexpr (std::is_signed_v<typename Raw::type>)
+            {
+                int64_t val = static_cast<int64_t>(arg);
+                line.appendRaw("i", 1);
+                line.appendRaw(&val, sizeof(val));
+            }
+            else
+            {
+                uint64_t val = static_cast<uint64_t>(arg);
+                line.appendRaw("u", 1);
+                line.appendRaw(&val, sizeof(val));
+            }
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            double val = static_cast<double>(arg);
+            line.appendRaw("f", 1);
+            line.appendRaw(&val, sizeof(val));
+        }
+        else
+        {
+            static_assert(std::is_convertible_v<const T &, std::string_view>, "unsupported binary log argument type");
+            std::string_view val(arg);
+            uint32_t length = static_cast<uint32_t>(val.size());
+            line.appendRaw("s", 1);
+            line.appendRaw(&length, sizeof(length));
+            line.appendRaw(val.data(), val.size());
         }
     }
 
+    static LogLine &threadLine();                                                   ///< 当前线程的格式化缓冲区
+    void commit(LogTarget target, LogLevel level, const char *text, size_t length); ///< 写入当前线程的环形缓冲区
+
+    class Backend;
+    std::unique_ptr<Backend> backend;
+    std::atomic<uint32_t> nextFormatId{1};
+
+    static inline std::atomic<int> runtimeLevel{0}; ///< 运行期最低级别的严重程度，默认全部输出
+
     static std::unique_ptr<LogTool> instance;
     static std::once_flag initInstanceFlag;
 };
 
-// 单例实例初始化
-std::unique_ptr<LogTool> LogTool::instance;
-std::once_flag LogTool::initInstanceFlag;
+// 级别关闭时参数不会被求值：编译期关闭的级别整段被丢弃，运行期关闭只剩一次原子读
+#define LOG_AT(level, ...)                                                  \
+    do                                                                      \
+    {                                                                       \
+        if constexpr (LogTool::compiledIn(level))                           \
+        {                                                                   \
+            if (LogTool::enabled(level))                                    \
+                LogTool::getInstance().appendLog(level, __VA_ARGS__);       \
+        }                                                                   \
+    } while (0)
+
+// 二进制日志，格式串在调用点首次执行时登记一次
+#define LOG_BIN(level, format, ...)                                                                           \
+    do                                                                                                        \
+    {                                                                                                         \
+        if constexpr (LogTool::compiledIn(level))                                                             \
+        {                                                                                                     \
+            if (LogTool::enabled(level))                                                                      \
+            {                                                                                                 \
+                static const uint32_t logFormatId = LogTool::getInstance().registerFormat(level, __FILE__, __LINE__, format); \
+                LogTool::getInstance().appendBinary(level, logFormatId __VA_OPT__(, ) __VA_ARGS__);          \
+            }                                                                                                 \
+        }                                                                                                     \
+    } while (0)
 
 // 定义全局日志函数
 #define LOG(...) LogTool::getInstance().printLog(LogTool::MSG, __VA_ARGS__)
-#define LOG_INFO(...) LogTool::getInstance().appendLog(LogTool::INFO, __VA_ARGS__)
-#define LOG_DEBUG(...) LogTool::getInstance().appendLog(LogTool::DEBUG, __VA_ARGS__)
-#define LOG_WARN(...) LogTool::getInstance().appendLog(LogTool::WARN, __VA_ARGS__)
-#define LOG_ERROR(...) LogTool::getInstance().appendLog(LogTool::ERROR, __VA_ARGS__)
\ No newline at end of file
+#define LOG_INFO(...) LOG_AT(LogTool::INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LogTool::DEBUG, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogTool::WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogTool::ERROR, __VA_ARGS__)
+#define LOG_BIN_INFO(format, ...) LOG_BIN(LogTool::INFO, format __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_BIN_DEBUG(format, ...) LOG_BIN(LogTool::DEBUG, format __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_BIN_WARN(format, ...) LOG_BIN(LogTool::WARN, format __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_BIN_ERROR(format, ...) LOG_BIN(LogTool::ERROR, format __VA_OPT__(, ) __VA_ARGS__)
+#endif
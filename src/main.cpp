@@ -1,7 +1,46 @@
+#include <csignal>
 #include <iostream>
 #include "Config.hpp"
+#include "LogTool.hpp"
+
+namespace
+{
+    /// @brief 配置文件重新加载后按其中的 log_level 调整日志运行期级别
+    class LogLevelObserver : public configObserver
+    {
+    public:
+        void stateChanged(const StateChangeEvent &event) override
+        {
+            if (event.getType() != StateType::ST_Update)
+                return;
+            auto snapshot = configManager::instance().getConfig(event.getMessage()); // ST_Update 的消息为配置文件路径
+            if (snapshot)
+                LogTool::applyConfig(snapshot->content);
+        }
+    };
+}
 
 int main(int argc, char const *argv[])
 {
+    // 先屏蔽退出信号再启动监听线程，线程继承屏蔽字，信号只由主线程的 sigwait 收取
+    sigset_t exitSignals;
+    sigemptyset(&exitSignals);
+    sigaddset(&exitSignals, SIGINT);
+    sigaddset(&exitSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &exitSignals, nullptr);
+
+    std::string configPath = argc > 1 ? argv[1] : "./test.json";
+    static LogLevelObserver logLevelObserver; // 先于 configManager 构造，晚于其析构
+    auto &manager = configManager::instance();
+    manager.addConfigFile(configPath, &logLevelObserver);
+    if (auto snapshot = manager.getConfig(configPath))
+        LogTool::applyConfig(snapshot->content); // 首次加载不通知观察者，这里直接应用
+    manager.watchConfig(configPath);
+
+    // 运行到 SIGINT/SIGTERM，期间配置文件的修改由 LogLevelObserver 应用
+    int signalNumber = 0;
+    sigwait(&exitSignals, &signalNumber);
+    std::cout << "收到信号 " << signalNumber << "，停止监听配置文件" << std::endl;
+    manager.stopWatch();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,165 @@
+#include "EventLoop.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventLoop::EventLoop(int thread_count)
+{
+    this->running = true;
+    for (int i = 0; i < std::max(thread_count, 1); i++)
+    {
+        auto poller = std::make_unique<Poller>();
+        poller->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        poller->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (poller->epollFd < 0 || poller->wakeFd < 0)
+        {
+            std::cerr << "创建 epoll 失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+            continue;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = poller->wakeFd;
+        epoll_ctl(poller->epollFd, EPOLL_CTL_ADD, poller->wakeFd, &event);
+        poller->thread = std::thread(&EventLoop::run, this, std::ref(*poller));
+        this->pollers.push_back(std::move(poller));
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    this->stop();
+}
+
+bool EventLoop::add(int fd, uint32_t events, IoHandler handler)
+{
+    if (fd < 0 || this->pollers.empty())
+        return false;
+    std::lock_guard<std::mutex> fdLock(this->fdMutex);
+    if (this->fdOwner.count(fd))
+        return false;
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        std::cerr << "设置非阻塞失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    auto index = this->nextPoller++ % this->pollers.size();
+    auto &poller = *this->pollers[index];
+    {
+        std::lock_guard<std::mutex> handlerLock(poller.handlerMutex);
+        poller.handlers[fd] = std::make_shared<IoHandler>(std::move(handler));
+    }
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(poller.epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        std::cerr << "epoll_ctl 添加失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+        std::lock_guard<std::mutex> handlerLock(poller.handlerMutex);
+        poller.handlers.erase(fd);
+        return false;
+    }
+    this->fdOwner[fd] = index;
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events)
+{
+    std::lock_guard<std::mutex> fdLock(this->fdMutex);
+    auto it = this->fdOwner.find(fd);
+    if (it == this->fdOwner.end())
+        return false;
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(this->pollers[it->second]->epollFd, EPOLL_CTL_MOD, fd, &event) < 0)
+    {
+        std::cerr << "epoll_ctl 修改失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::remove(int fd)
+{
+    Poller *poller = nullptr;
+    {
+        std::lock_guard<std::mutex> fdLock(this->fdMutex);
+        auto it = this->fdOwner.find(fd);
+        if (it == this->fdOwner.end())
+            return false;
+        poller = this->pollers[it->second].get();
+        this->fdOwner.erase(it);
+    }
+    {
+        std::lock_guard<std::mutex> handlerLock(poller->handlerMutex);
+        poller->handlers.erase(fd);
+        epoll_ctl(poller->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    // 回调在加锁时登记 dispatchingFd，这里解锁后等待即可保证回调不再访问调用方的资源
+    if (std::this_thread::get_id() != poller->thread.get_id())
+    {
+        while (poller->dispatchingFd.load(std::memory_order_acquire) == fd)
+            std::this_thread::yield();
+    }
+    return true;
+}
+
+void EventLoop::stop()
+{
+    if (!this->running.exchange(false))
+        return;
+    for (auto &t_poller : this->pollers)
+    {
+        uint64_t one = 1;
+        write(t_poller->wakeFd, &one, sizeof(one));
+    }
+    for (auto &t_poller : this->pollers)
+    {
+        if (t_poller->thread.joinable())
+            t_poller->thread.join();
+        close(t_poller->wakeFd);
+        close(t_poller->epollFd);
+    }
+}
+
+void EventLoop::run(Poller &poller)
+{
+    constexpr int maxEvents = 64;
+    epoll_event events[maxEvents];
+    while (this->running)
+    {
+        int eventCount = epoll_wait(poller.epollFd, events, maxEvents, -1);
+        if (eventCount < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "epoll_wait 失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < eventCount; i++)
+        {
+            int t_fd = events[i].data.fd;
+            if (t_fd == poller.wakeFd)
+                continue;
+            std::shared_ptr<IoHandler> t_handler;
+            {
+                std::lock_guard<std::mutex> handlerLock(poller.handlerMutex);
+                auto it = poller.handlers.find(t_fd);
+                if (it == poller.handlers.end())
+                    continue; // 同一轮中已被移除
+                t_handler = it->second;
+                poller.dispatchingFd.store(t_fd, std::memory_order_release);
+            }
+            (*t_handler)(events[i].events);
+            poller.dispatchingFd.store(-1, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef _EventLoop_hpp_
+#define _EventLoop_hpp_
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// @brief 基于 epoll 的事件循环，用固定数量的线程复用所有套接字的接收
+/// 每个线程持有一个 epoll 实例，加入的 fd 按轮询分配到各线程，同一个 fd 的回调始终在同一线程上执行。
+/// 采用水平触发，回调每次只需处理有限的数据，剩余数据会在下一轮再次触发，避免单个 fd 饿死其他 fd。
+class EventLoop
+{
+public:
+    /// 事件回调，events 为 epoll 返回的事件位
+    using IoHandler = std::function<void(uint32_t events)>;
+
+    explicit EventLoop(int thread_count = 1);
+    ~EventLoop();
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /// @brief 加入 fd 并设为非阻塞
+    /// @return fd 已存在或 epoll_ctl 失败时返回 false
+    bool add(int fd, uint32_t events, IoHandler handler);
+
+    /// @brief 修改已加入 fd 关注的事件，events 为 0 时暂停读写事件（EPOLLERR/EPOLLHUP 仍会上报）
+    bool modify(int fd, uint32_t events);
+
+    /// @brief 移除 fd，若该 fd 的回调正在其他线程执行则等待其返回；在回调内部移除自身是安全的
+    bool remove(int fd);
+
+    void stop();                                       ///< 停止并回收所有循环线程
+    size_t threadCount() const { return pollers.size(); }
+
+private:
+    struct Poller
+    {
+        int epollFd = -1;
+        int wakeFd = -1;                                           ///< eventfd，用于唤醒退出
+        std::thread thread;
+        std::mutex handlerMutex;
+        std::unordered_map<int, std::shared_ptr<IoHandler>> handlers; ///< fd 到回调
+        std::atomic<int> dispatchingFd{-1};                        ///< 正在执行回调的 fd
+    };
+
+    void run(Poller &poller);
+
+    std::vector<std::unique_ptr<Poller>> pollers;
+    std::mutex fdMutex;
+    std::unordered_map<int, size_t> fdOwner; ///< fd 所属的 poller 下标
+    std::atomic<size_t> nextPoller{0};
+    std::atomic<bool> running{false};
+};
+#endif
@@ -0,0 +1,316 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+size_t metricShard()
+{
+    static std::atomic<size_t> nextShard{0};
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % metricShards;
+    return shard;
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < subBuckets)
+        return value;
+    unsigned exponent = 63 - __builtin_clzll(value);
+    if (exponent > maxExponent)
+        return bucketCount - 1;
+    auto sub = (value >> (exponent - subBucketBits)) & (subBuckets - 1);
+    return (exponent - subBucketBits + 1) * subBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpper(size_t index)
+{
+    if (index < subBuckets)
+        return index;
+    auto exponent = index / subBuckets + subBucketBits - 1;
+    auto sub = index % subBuckets;
+    auto width = 1ull << (exponent - subBucketBits);
+    return ((subBuckets + sub) << (exponent - subBucketBits)) + width - 1;
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(bucketCount, 0);
+    for (const auto &t_shard : this->shards)
+    {
+        for (size_t i = 0; i < bucketCount; i++)
+            snapshot.buckets[i] += t_shard.buckets[i].load(std::memory_order_relaxed);
+        snapshot.sum += t_shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, t_shard.max.load(std::memory_order_relaxed));
+    }
+    // 按桶重新求和，保证与桶计数一致（记录中途读取时 sum 与桶可能差一次）
+    for (auto t_count : snapshot.buckets)
+        snapshot.count += t_count;
+    return snapshot;
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const
+{
+    if (this->count == 0)
+        return 0;
+    auto rank = static_cast<uint64_t>(p / 100.0 * this->count + 0.5);
+    rank = std::min(std::max<uint64_t>(rank, 1), this->count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < this->buckets.size(); i++)
+    {
+        seen += this->buckets[i];
+        if (seen >= rank)
+            return std::min(LatencyHistogram::bucketUpper(i), this->max);
+    }
+    return this->max;
+}
+
+MetricsRegistry &MetricsRegistry::getInstance()
+{
+    static MetricsRegistry instance;
+    return instance;
+}
+
+MetricCounter &MetricsRegistry::counter(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(this->metricsMutex);
+    auto &slot = this->counters[name];
+    if (!slot)
+        slot = std::make_unique<MetricCounter>();
+    return *slot;
+}
+
+LatencyHistogram &MetricsRegistry::histogram(const std::string &name, uint32_t sample_every)
+{
+    std::lock_guard<std::mutex> lock(this->metricsMutex);
+    auto &slot = this->histograms[name];
+    if (!slot)
+        slot = std::make_unique<LatencyHistogram>(sample_every);
+    return *slot;
+}
+
+StageMetrics MetricsRegistry::stage(const std::string &prefix, uint32_t sample_every)
+{
+    StageMetrics metrics;
+    metrics.packets = &this->counter(prefix + ".packets");
+    metrics.bytes = &this->counter(prefix + ".bytes");
+    metrics.dropped = &this->counter(prefix + ".dropped");
+    metrics.errors = &this->counter(prefix + ".errors");
+    metrics.latency = &this->histogram(prefix + ".latency_ns", sample_every);
+    return metrics;
+}
+
+namespace
+{
+    constexpr double snapshotPercentiles[] = {50, 90, 99, 99.9};
+    constexpr const char *percentileNames[] = {"p50", "p90", "p99", "p999"};
+
+    // 指标名只含字母、数字与 .:_-，仍按 JSON 规则转义引号与反斜杠
+    void appendJsonString(std::string &out, const std::string &text)
+    {
+        out.push_back('"');
+        for (char t_char : text)
+        {
+            if (t_char == '"' || t_char == '\\')
+                out.push_back('\\');
+            out.push_back(t_char);
+        }
+        out.push_back('"');
+    }
+}
+
+std::string MetricsRegistry::toText() const
+{
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(this->metricsMutex);
+    for (const auto &[t_name, t_counter] : this->counters)
+        out << t_name << ' ' << t_counter->value() << '\n';
+    for (const auto &[t_name, t_histogram] : this->histograms)
+    {
+        auto t_snapshot = t_histogram->snapshot();
+        out << t_name << " count=" << t_snapshot.count << " mean=" << static_cast<uint64_t>(t_snapshot.mean());
+        for (size_t i = 0; i < std::size(snapshotPercentiles); i++)
+            out << ' ' << percentileNames[i] << '=' << t_snapshot.percentile(snapshotPercentiles[i]);
+        out << " max=" << t_snapshot.max;
+        if (t_histogram->sampleRate() > 1)
+            out << " sample=1/" << t_histogram->sampleRate();
+        out << '\n';
+    }
+    return out.str();
+}
+
+std::string MetricsRegistry::toJson() const
+{
+    std::string out = "{\"time_ns\": ";
+    out += std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    std::lock_guard<std::mutex> lock(this->metricsMutex);
+    out += ", \"counters\": {";
+    bool first = true;
+    for (const auto &[t_name, t_counter] : this->counters)
+    {
+        out += first ? "" : ", ";
+        first = false;
+        appendJsonString(out, t_name);
+        out += ": " + std::to_string(t_counter->value());
+    }
+    out += "}, \"histograms\": {";
+    first = true;
+    for (const auto &[t_name, t_histogram] : this->histograms)
+    {
+        auto t_snapshot = t_histogram->snapshot();
+        out += first ? "" : ", ";
+        first = false;
+        appendJsonString(out, t_name);
+        out += ": {\"count\": " + std::to_string(t_snapshot.count);
+        out += ", \"mean\": " + std::to_string(static_cast<uint64_t>(t_snapshot.mean()));
+        for (size_t i = 0; i < std::size(snapshotPercentiles); i++)
+            out += std::string(", \"") + percentileNames[i] + "\": " + std::to_string(t_snapshot.percentile(snapshotPercentiles[i]));
+        out += ", \"max\": " + std::to_string(t_snapshot.max);
+        out += ", \"sample_every\": " + std::to_string(t_histogram->sampleRate()) + "}";
+    }
+    out += "}}\n";
+    return out;
+}
+
+bool MetricsRegistry::writeFile(const std::string &path, bool json) const
+{
+    auto tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "无法写入指标文件: " << tempPath << std::endl;
+            return false;
+        }
+        file << (json ? this->toJson() : this->toText());
+        if (!file)
+            return false;
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "指标文件重命名失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    this->stop();
+}
+
+bool MetricsExporter::start(const std::string &file_path, const std::string &socket_path, std::chrono::milliseconds interval)
+{
+    if (this->running || (file_path.empty() && socket_path.empty()))
+        return false;
+    this->filePath = file_path;
+    this->socketPath = socket_path;
+    this->interval = interval;
+    if (!socket_path.empty())
+    {
+        sockaddr_un addr = {};
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "指标套接字路径过长: " << socket_path << std::endl;
+            return false;
+        }
+        this->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size());
+        ::unlink(socket_path.c_str()); // 上次异常退出留下的套接字文件
+        if (this->listenFd < 0 || ::bind(this->listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(this->listenFd, 8) < 0)
+        {
+            std::cerr << "指标套接字监听失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+            if (this->listenFd >= 0)
+                ::close(this->listenFd);
+            this->listenFd = -1;
+            return false;
+        }
+    }
+    this->wakeFd = eventfd(0, EFD_CLOEXEC);
+    this->running = true;
+    this->thread = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop()
+{
+    if (!this->running.exchange(false))
+        return;
+    uint64_t one = 1;
+    if (::write(this->wakeFd, &one, sizeof(one)) < 0)
+        std::cerr << "唤醒指标导出线程失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+    if (this->thread.joinable())
+        this->thread.join();
+    if (!this->filePath.empty())
+        MetricsRegistry::getInstance().writeFile(this->filePath);
+    if (this->listenFd >= 0)
+    {
+        ::close(this->listenFd);
+        ::unlink(this->socketPath.c_str());
+        this->listenFd = -1;
+    }
+    ::close(this->wakeFd);
+    this->wakeFd = -1;
+}
+
+void MetricsExporter::run()
+{
+    auto &registry = MetricsRegistry::getInstance();
+    auto nextWrite = std::chrono::steady_clock::now();
+    while (this->running)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (!this->filePath.empty() && now >= nextWrite)
+        {
+            registry.writeFile(this->filePath);
+            nextWrite = now + this->interval;
+        }
+        pollfd pfds[2] = {{this->wakeFd, POLLIN, 0}, {this->listenFd, POLLIN, 0}};
+        auto timeout = this->filePath.empty() ? -1 : std::chrono::duration_cast<std::chrono::milliseconds>(nextWrite - now).count();
+        if (::poll(pfds, this->listenFd >= 0 ? 2 : 1, static_cast<int>(timeout)) <= 0)
+            continue;
+        if (pfds[0].revents)
+            break;
+        if (pfds[1].revents & POLLIN)
+        {
+            int clientFd = accept4(this->listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (clientFd >= 0)
+            {
+                this->answer(clientFd);
+                ::close(clientFd);
+            }
+        }
+    }
+}
+
+void MetricsExporter::answer(int client_fd) const
+{
+    // 最多等 100ms 读取请求，客户端不发送时按 JSON 应答
+    char request[16] = {};
+    pollfd pfd = {client_fd, POLLIN, 0};
+    if (::poll(&pfd, 1, 100) > 0)
+    {
+        auto readBytes = ::recv(client_fd, request, sizeof(request) - 1, 0);
+        request[readBytes > 0 ? readBytes : 0] = '\0';
+    }
+    auto &registry = MetricsRegistry::getInstance();
+    auto reply = std::strncmp(request, "text", 4) == 0 ? registry.toText() : registry.toJson();
+    size_t sent = 0;
+    while (sent < reply.size())
+    {
+        auto sendBytes = ::send(client_fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+        if (sendBytes <= 0)
+            return;
+        sent += sendBytes;
+    }
+}
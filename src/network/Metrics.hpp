@@ -0,0 +1,210 @@
+#ifndef _Metrics_hpp_
+#define _Metrics_hpp_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PacketRing.hpp"
+
+/// 计数器与直方图的分片数，线程按首次使用的顺序分到各分片，记录时只写本分片所在的缓存行
+constexpr size_t metricShards = 16;
+
+/// 逐包阶段（过滤、分类、解码、解析）的计时采样间隔，计数不采样
+constexpr uint32_t packetSampleEvery = 64;
+
+/// @brief 当前线程使用的分片下标
+size_t metricShard();
+
+/// @brief 分片计数器：记录时对本线程分片做一次 relaxed 原子加，读取时汇总所有分片
+class MetricCounter
+{
+public:
+    void add(uint64_t delta = 1)
+    {
+        this->shards[metricShard()].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t total = 0;
+        for (const auto &t_shard : this->shards)
+            total += t_shard.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    struct alignas(cacheLineSize) Shard
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, metricShards> shards;
+};
+
+/// @brief 直方图汇总快照，单位与记录值一致（纳秒）
+struct HistogramSnapshot
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> buckets; ///< 各桶计数，下标见 LatencyHistogram::bucketIndex
+
+    double mean() const { return count ? double(sum) / count : 0; }
+    /// 百分位（0~100），返回所在桶的上界，相对误差不超过 1/LatencyHistogram::subBuckets
+    uint64_t percentile(double p) const;
+};
+
+/// @brief HDR 风格的对数-线性直方图：每个 2 的幂区间再等分为 subBuckets 个桶，
+/// 记录只是一次桶下标计算加本线程分片上的两次 relaxed 原子加，不加锁也不分配。
+/// sample_every 大于 1 时只对每个线程每 N 次调用中的一次计时，见 ScopedLatency。
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned subBucketBits = 3;
+    static constexpr uint64_t subBuckets = 1ull << subBucketBits;
+    static constexpr unsigned maxExponent = 40;                                      ///< 超过 2^40 ns（约 18 分钟）的值记入最后一个桶
+    static constexpr size_t bucketCount = (maxExponent - subBucketBits + 2) * subBuckets; ///< 前 subBuckets 个桶是 [0, subBuckets) 的精确值
+
+    explicit LatencyHistogram(uint32_t sample_every = 1) : sampleEvery(sample_every ? sample_every : 1) {}
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpper(size_t index); ///< 桶内最大值
+
+    void record(uint64_t value)
+    {
+        auto &shard = this->shards[metricShard()];
+        shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+        auto max = shard.max.load(std::memory_order_relaxed);
+        while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /// 本次调用是否需要计时，按本线程分片轮转
+    bool sampled()
+    {
+        if (this->sampleEvery == 1)
+            return true;
+        return this->shards[metricShard()].tick.fetch_add(1, std::memory_order_relaxed) % this->sampleEvery == 0;
+    }
+
+    uint32_t sampleRate() const { return this->sampleEvery; }
+    HistogramSnapshot snapshot() const;
+
+private:
+    struct alignas(cacheLineSize) Shard
+    {
+        std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> tick{0};
+    };
+
+    uint32_t sampleEvery;
+    std::array<Shard, metricShards> shards;
+};
+
+/// @brief 作用域计时：构造时若该次被采样则取时间，析构时把经过的纳秒数记入直方图；histogram 为空时什么都不做
+class ScopedLatency
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedLatency(LatencyHistogram *latency_histogram)
+        : histogram(latency_histogram && latency_histogram->sampled() ? latency_histogram : nullptr)
+    {
+        if (this->histogram)
+            this->begin = Clock::now();
+    }
+    ScopedLatency(const ScopedLatency &) = delete;
+    ScopedLatency &operator=(const ScopedLatency &) = delete;
+    ~ScopedLatency()
+    {
+        if (this->histogram)
+            this->histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - this->begin).count());
+    }
+
+private:
+    LatencyHistogram *histogram;
+    Clock::time_point begin;
+};
+
+/// @brief 一个处理阶段（接收、过滤、分类、解析）的一组指标，名称为 <前缀>.<指标>
+/// 指针指向 MetricsRegistry 中的对象，进程内一直有效
+struct StageMetrics
+{
+    MetricCounter *packets = nullptr; ///< 进入该阶段的数据包（或接收次数）
+    MetricCounter *bytes = nullptr;   ///< 字节数
+    MetricCounter *dropped = nullptr; ///< 在该阶段被丢弃（未通过过滤、未能分类、长度不足等）
+    MetricCounter *errors = nullptr;  ///< 出错次数（系统调用失败、解析异常）
+    LatencyHistogram *latency = nullptr; ///< 阶段耗时，纳秒
+
+    explicit operator bool() const { return this->packets != nullptr; }
+};
+
+/// @brief 进程内的指标注册表（单例）
+/// 指标按名称创建后不再释放，同名的指标是同一个对象：同一端口上重建的套接字、同一规则的多个解析器实例累加到同一组指标。
+/// 名称约定为点分层级，例如 udp.0.0.0.0:9000.recv.packets、parser.demo.filter.dropped。
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &getInstance();
+
+    MetricCounter &counter(const std::string &name);
+    LatencyHistogram &histogram(const std::string &name, uint32_t sample_every = 1); ///< sample_every 只在首次创建时生效
+    /// 注册 <prefix>.packets/bytes/dropped/errors 计数与 <prefix>.latency_ns 直方图
+    StageMetrics stage(const std::string &prefix, uint32_t sample_every = 1);
+
+    /// @brief 文本快照，每个指标一行；直方图输出 count、mean、p50、p90、p99、p999、max
+    std::string toText() const;
+    /// @brief JSON 快照：{"time_ns": ..., "counters": {名称: 值}, "histograms": {名称: {count, mean, p50, ...}}}
+    std::string toJson() const;
+    /// @brief 把快照写入文件（先写临时文件再 rename，读者不会读到半个文件），json 为 false 时写文本
+    bool writeFile(const std::string &path, bool json = true) const;
+
+private:
+    MetricsRegistry() = default;
+
+    mutable std::mutex metricsMutex; ///< 只保护两张表的增删，记录不取它
+    std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+};
+
+/// @brief 指标导出：后台线程按周期把快照写入文件，并可在本地 Unix 域套接字上应答快照
+/// 连上套接字的客户端发送 "text" 时得到文本快照，其余（或不发送、直接关闭写端）得到 JSON，应答后即关闭连接，
+/// 例如 `socat - UNIX-CONNECT:/tmp/protocol.metrics`。
+class MetricsExporter
+{
+public:
+    MetricsExporter() = default;
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    /// @brief 启动导出线程
+    /// @param file_path 周期写入的文件，为空时不写文件
+    /// @param socket_path Unix 域套接字路径，为空时不监听
+    /// @param interval 写文件的周期
+    bool start(const std::string &file_path, const std::string &socket_path = "",
+               std::chrono::milliseconds interval = std::chrono::seconds(1));
+    void stop(); ///< 停止线程，最后写一次文件并删除套接字文件
+
+private:
+    void run();
+    void answer(int client_fd) const;
+
+    std::string filePath;
+    std::string socketPath;
+    std::chrono::milliseconds interval{1000};
+    int listenFd = -1;
+    int wakeFd = -1; ///< eventfd，用于唤醒退出
+    std::thread thread;
+    std::atomic<bool> running{false};
+};
+#endif
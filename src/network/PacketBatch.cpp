@@ -0,0 +1,109 @@
+#include "PacketBatch.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+
+PacketBatch::PacketBatch(int batch_size, int slot_size)
+    : slotSize(std::max(slot_size, 1)),
+      headers(std::max(batch_size, 1)),
+      iovecs(std::max(batch_size, 1)),
+      addrs(std::max(batch_size, 1)),
+      addrInfos(std::max(batch_size, 1)),
+      addrReady(std::max(batch_size, 1), 0),
+      controlSize(recvTimeControlSize()),
+      controls(size_t(std::max(batch_size, 1)) * recvTimeControlSize()),
+      recvTimes(std::max(batch_size, 1))
+{
+    auto &pool = BufferPool::forSize(this->slotSize);
+    this->slots.reserve(this->headers.size());
+    for (size_t i = 0; i < this->headers.size(); i++)
+    {
+        this->slots.emplace_back(pool);
+        this->iovecs[i].iov_len = this->slotSize;
+        this->headers[i] = {};
+        this->headers[i].msg_hdr.msg_iov = &this->iovecs[i];
+        this->headers[i].msg_hdr.msg_iovlen = 1;
+        this->headers[i].msg_hdr.msg_name = &this->addrs[i];
+        this->headers[i].msg_hdr.msg_control = this->controls.data() + i * this->controlSize;
+    }
+}
+
+size_t recvTimeControlSize()
+{
+    return CMSG_SPACE(sizeof(timespec));
+}
+
+bool kernelRecvTime(const msghdr &header, PacketView::Clock::time_point &recv_time)
+{
+    if (header.msg_controllen == 0)
+        return false;
+    for (auto *t_cmsg = CMSG_FIRSTHDR(&header); t_cmsg; t_cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&header), t_cmsg))
+    {
+        if (t_cmsg->cmsg_level != SOL_SOCKET || t_cmsg->cmsg_type != SCM_TIMESTAMPNS)
+            continue;
+        timespec t_stamp;
+        std::memcpy(&t_stamp, CMSG_DATA(t_cmsg), sizeof(t_stamp));
+        recv_time = PacketView::Clock::time_point(std::chrono::duration_cast<PacketView::Clock::duration>(
+            std::chrono::seconds(t_stamp.tv_sec) + std::chrono::nanoseconds(t_stamp.tv_nsec)));
+        return true;
+    }
+    return false;
+}
+
+int PacketBatch::receive(int socket_fd)
+{
+    // 内核会改写 msg_namelen 与 msg_controllen，每次接收前重置；上一批被持有的缓冲区在这里换新
+    size_t ready = 0;
+    for (; ready < this->headers.size(); ready++)
+    {
+        auto *t_buffer = this->slots[ready].prepare();
+        if (!t_buffer)
+            break;
+        this->iovecs[ready].iov_base = t_buffer;
+        this->headers[ready].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        this->headers[ready].msg_hdr.msg_controllen = this->controlSize;
+    }
+    if (ready == 0)
+    {
+        this->count = 0;
+        errno = ENOBUFS;
+        return -1;
+    }
+    int recvCount = recvmmsg(socket_fd, this->headers.data(), ready, MSG_WAITFORONE, nullptr);
+    if (recvCount < 0)
+    {
+        this->count = 0;
+        return -1;
+    }
+    this->recvTimestamp = PacketView::Clock::now();
+    this->count = recvCount;
+    this->kernelStampCount = 0;
+    for (int i = 0; i < recvCount; i++)
+    {
+        this->recvTimes[i] = this->recvTimestamp;
+        this->kernelStampCount += kernelRecvTime(this->headers[i].msg_hdr, this->recvTimes[i]) ? 1 : 0;
+    }
+    std::fill(this->addrReady.begin(), this->addrReady.begin() + recvCount, 0);
+    return recvCount;
+}
+
+const AddrInfo &PacketBatch::addrInfo(size_t index)
+{
+    if (!this->addrReady[index])
+    {
+        char ipStr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(this->addrs[index].sin_addr), ipStr, sizeof(ipStr));
+        this->addrInfos[index].ip = ipStr;
+        this->addrInfos[index].port = ntohs(this->addrs[index].sin_port);
+        this->addrReady[index] = 1;
+    }
+    return this->addrInfos[index];
+}
+
+PacketView PacketBatch::view(size_t index)
+{
+    PacketView packet(this->data(index), this->length(index), this->addrInfo(index), this->recvTimes[index]);
+    packet.slab = this->slots[index].current();
+    return packet;
+}
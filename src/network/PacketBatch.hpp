@@ -0,0 +1,63 @@
+#ifndef _PacketBatch_hpp_
+#define _PacketBatch_hpp_
+#include <cstdint>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "PacketView.hpp"
+#include "PacketBuffer.hpp"
+
+constexpr int defaultRecvBatchSize = 32; ///< 默认每次系统调用最多收取的数据报个数
+
+/// @brief 从 recvmsg/recvmmsg 返回的控制消息中取出内核接收时间戳（SCM_TIMESTAMPNS）
+/// @return 套接字未开启 SO_TIMESTAMPNS 或控制消息中没有时间戳时返回 false，recv_time 不变
+bool kernelRecvTime(const msghdr &header, PacketView::Clock::time_point &recv_time);
+/// 容纳一个 SCM_TIMESTAMPNS 控制消息所需的缓冲区字节数
+size_t recvTimeControlSize();
+
+/// @brief recvmmsg 批量接收的槽位组
+/// 每个槽位的缓冲区取自共用的 BufferPool（BufferPool::forSize(slot_size)），mmsghdr、iovec 与地址在构造时一次性分配。
+/// 回调中被 PacketRef 持有的缓冲区留给使用者，下次接收前该槽位换上池中的另一块，未被持有的原地复用，稳定运行后不再分配内存。
+/// 对端地址先以 sockaddr_in 保存，调用 addrInfo()/view() 时才转换成字符串。
+/// 每个槽位带一个控制消息缓冲区：套接字开启 SO_TIMESTAMPNS 后，每个数据报使用内核记录的到达时间，否则使用本批次返回时的时间。
+class PacketBatch
+{
+public:
+    /// @param batch_size 槽位个数，即单次系统调用最多收取的数据报数
+    /// @param slot_size 单个槽位的字节数，超长数据报会被截断
+    PacketBatch(int batch_size, int slot_size);
+    PacketBatch(const PacketBatch &) = delete;
+    PacketBatch &operator=(const PacketBatch &) = delete;
+
+    /// @brief 阻塞直到至少收到一个数据报，再非阻塞地取走其余已到达的数据报
+    /// @return 收到的数据报个数，失败返回 -1 并保留 errno；缓冲池达到上限、一个槽位都备不齐时 errno 为 ENOBUFS
+    int receive(int socket_fd);
+
+    size_t size() const { return count; }
+    size_t capacity() const { return headers.size(); }
+    const uint8_t *data(size_t index) const { return slots[index].data(); }
+    size_t length(size_t index) const { return headers[index].msg_len; }
+    const sockaddr_in &rawAddr(size_t index) const { return addrs[index]; }
+    PacketView::Clock::time_point recvTime() const { return recvTimestamp; }        ///< 本批次从 recvmmsg 返回的时间
+    PacketView::Clock::time_point recvTime(size_t index) const { return recvTimes[index]; } ///< 数据报的接收时间，有内核时间戳时为内核时间
+    size_t kernelStamped() const { return kernelStampCount; }                      ///< 本批次中带内核时间戳的数据报个数
+
+    const AddrInfo &addrInfo(size_t index); ///< 首次访问时才做 inet_ntop 转换
+    PacketView view(size_t index);          ///< 第 index 个数据报的视图，在下一次 receive 之前有效
+
+private:
+    size_t slotSize;
+    size_t count = 0;
+    std::vector<ReceiveSlot> slots;   ///< 每个槽位的池化接收缓冲区
+    std::vector<mmsghdr> headers;     ///< recvmmsg 消息头
+    std::vector<iovec> iovecs;        ///< 每个槽位的缓冲区描述
+    std::vector<sockaddr_in> addrs;   ///< 原始对端地址
+    std::vector<AddrInfo> addrInfos;  ///< 已转换的对端地址缓存
+    std::vector<uint8_t> addrReady;   ///< addrInfos 中对应项是否已转换
+    size_t controlSize;
+    std::vector<uint8_t> controls;    ///< 所有槽位共用的控制消息缓冲区，每个槽位 controlSize 字节
+    std::vector<PacketView::Clock::time_point> recvTimes; ///< 每个数据报的接收时间
+    size_t kernelStampCount = 0;
+    PacketView::Clock::time_point recvTimestamp; ///< 本批次的接收时间，没有内核时间戳的数据报使用它
+};
+#endif
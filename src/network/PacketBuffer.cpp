@@ -0,0 +1,183 @@
+#include "PacketBuffer.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+
+void PacketSlab::release()
+{
+    if (this->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        this->pool->recycle(this);
+}
+
+BufferPool::BufferPool(size_t slab_size, size_t max_slabs, size_t chunk_slabs)
+    : dataSize(slab_size), maxSlabs(max_slabs), chunkSlabs(std::max<size_t>(chunk_slabs, 1))
+{
+    this->strideSize = (sizeof(PacketSlab) + slab_size + cacheLineSize - 1) / cacheLineSize * cacheLineSize;
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto *t_chunk : this->chunks)
+        std::free(t_chunk);
+}
+
+BufferPool &BufferPool::forSize(size_t min_size)
+{
+    static std::mutex poolsMutex;
+    static std::map<size_t, std::unique_ptr<BufferPool>> pools;
+    size_t size = 4096;
+    while (size < min_size)
+        size <<= 1;
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    auto &pool = pools[size];
+    if (!pool)
+        pool = std::make_unique<BufferPool>(size);
+    return *pool;
+}
+
+size_t BufferPool::threadStripe()
+{
+    static std::atomic<size_t> nextStripe{0};
+    thread_local size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % stripeCount;
+    return stripe;
+}
+
+PacketSlab *BufferPool::acquire()
+{
+    auto stripeIndex = threadStripe();
+    PacketSlab *slab = nullptr;
+    {
+        auto &stripe = this->stripes[stripeIndex];
+        std::lock_guard<std::mutex> lock(stripe.stripeMutex);
+        if (!stripe.freeSlabs.empty())
+        {
+            slab = stripe.freeSlabs.back();
+            stripe.freeSlabs.pop_back();
+        }
+    }
+    if (!slab)
+        slab = this->steal(stripeIndex);
+    if (!slab)
+        slab = this->grow(stripeIndex);
+    if (!slab)
+    {
+        this->exhausted.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    slab->refs.store(1, std::memory_order_relaxed);
+    this->acquired.fetch_add(1, std::memory_order_relaxed);
+    return slab;
+}
+
+void BufferPool::recycle(PacketSlab *slab)
+{
+    auto &stripe = this->stripes[threadStripe()];
+    std::lock_guard<std::mutex> lock(stripe.stripeMutex);
+    stripe.freeSlabs.push_back(slab);
+}
+
+PacketSlab *BufferPool::steal(size_t stripe_index)
+{
+    // 使用者线程释放的缓冲区落在它自己的条带上，接收线程在这里成批取回
+    // 同时持有两个条带的锁直接搬移，不经过临时容器；条带的 vector 容量稳定后不再分配
+    auto &stripe = this->stripes[stripe_index];
+    for (size_t i = 1; i < stripeCount; i++)
+    {
+        auto &t_victim = this->stripes[(stripe_index + i) % stripeCount];
+        std::scoped_lock lock(stripe.stripeMutex, t_victim.stripeMutex);
+        if (t_victim.freeSlabs.empty())
+            continue;
+        auto t_keep = t_victim.freeSlabs.size() / 2;
+        auto *slab = t_victim.freeSlabs.back();
+        stripe.freeSlabs.insert(stripe.freeSlabs.end(), t_victim.freeSlabs.begin() + t_keep, t_victim.freeSlabs.end() - 1);
+        t_victim.freeSlabs.resize(t_keep);
+        return slab;
+    }
+    return nullptr;
+}
+
+PacketSlab *BufferPool::grow(size_t stripe_index)
+{
+    size_t count = this->chunkSlabs;
+    std::lock_guard<std::mutex> lock(this->chunkMutex);
+    auto total = this->allocated.load(std::memory_order_relaxed);
+    if (this->maxSlabs)
+    {
+        if (total >= this->maxSlabs)
+            return nullptr;
+        count = std::min(count, this->maxSlabs - total);
+    }
+    auto *chunk = static_cast<uint8_t *>(std::aligned_alloc(cacheLineSize, count * this->strideSize));
+    if (!chunk)
+        return nullptr;
+    std::memset(chunk, 0, count * this->strideSize); // 由申请线程首次写入，页面落在该线程所在的 NUMA 节点
+    this->chunks.push_back(chunk);
+    this->allocated.store(total + count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto *t_slab = new (chunk + i * this->strideSize) PacketSlab();
+        t_slab->pool = this;
+    }
+    // 第一个缓冲区直接返回，其余放入当前条带
+    auto &stripe = this->stripes[stripe_index];
+    std::lock_guard<std::mutex> stripeLock(stripe.stripeMutex);
+    for (size_t i = 1; i < count; i++)
+        stripe.freeSlabs.push_back(reinterpret_cast<PacketSlab *>(chunk + i * this->strideSize));
+    return reinterpret_cast<PacketSlab *>(chunk);
+}
+
+BufferPoolStats BufferPool::stats() const
+{
+    BufferPoolStats res;
+    res.slabSize = this->dataSize;
+    res.allocated = this->allocated.load(std::memory_order_relaxed);
+    res.acquired = this->acquired.load(std::memory_order_relaxed);
+    res.exhausted = this->exhausted.load(std::memory_order_relaxed);
+    return res;
+}
+
+PacketRef::PacketRef(const PacketView &packet) : viewData(packet)
+{
+    if (packet.slab)
+    {
+        this->slab = packet.slab;
+        this->slab->retain();
+        return;
+    }
+    // 不在池化缓冲区中的数据（回放、分帧后的重组数据等）拷贝一份
+    this->slab = BufferPool::forSize(packet.length).acquire();
+    if (!this->slab)
+    {
+        this->viewData = PacketView(); // 池达到上限，保持为空引用
+        return;
+    }
+    if (packet.length)
+        std::memcpy(this->slab->data(), packet.data, packet.length);
+    this->viewData.data = this->slab->data();
+    this->viewData.slab = this->slab;
+}
+
+PacketRef::PacketRef(const PacketRef &other) : slab(other.slab), viewData(other.viewData)
+{
+    if (this->slab)
+        this->slab->retain();
+}
+
+PacketRef::PacketRef(PacketRef &&other) noexcept : slab(std::exchange(other.slab, nullptr)), viewData(std::move(other.viewData))
+{
+}
+
+PacketRef &PacketRef::operator=(PacketRef other) noexcept
+{
+    std::swap(this->slab, other.slab);
+    std::swap(this->viewData, other.viewData);
+    return *this;
+}
+
+void PacketRef::reset()
+{
+    if (this->slab)
+        std::exchange(this->slab, nullptr)->release();
+    this->viewData = PacketView();
+}
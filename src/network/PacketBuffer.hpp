@@ -0,0 +1,155 @@
+#ifndef _PacketBuffer_hpp_
+#define _PacketBuffer_hpp_
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "PacketView.hpp"
+#include "PacketRing.hpp"
+
+class BufferPool;
+
+/// @brief 缓冲池中的一块定长缓冲区，头部之后紧跟 BufferPool::slabSize() 字节的数据区
+/// 引用计数归零时回到所属的池；接收循环持有一个引用，使用者通过 PacketRef 再持有一个
+struct alignas(cacheLineSize) PacketSlab
+{
+    std::atomic<uint32_t> refs{0};
+    BufferPool *pool = nullptr;
+
+    uint8_t *data() { return reinterpret_cast<uint8_t *>(this) + sizeof(PacketSlab); }
+    bool shared() const { return this->refs.load(std::memory_order_acquire) > 1; } ///< 除接收循环外还有使用者持有
+    void retain() { this->refs.fetch_add(1, std::memory_order_relaxed); }
+    void release(); ///< 计数归零时回到池
+};
+
+/// @brief 缓冲池计数快照
+struct BufferPoolStats
+{
+    size_t slabSize = 0;
+    uint64_t allocated = 0; ///< 已向系统申请的缓冲区总数，稳定运行后不再增长
+    uint64_t acquired = 0;  ///< acquire 成功次数
+    uint64_t exhausted = 0; ///< 达到上限而 acquire 失败的次数
+};
+
+/// @brief 定长缓冲区池，所有套接字共用（按缓冲区大小各一个，见 forSize）
+/// 缓冲区按块（chunk_slabs 个）一次性申请并由申请线程写零，按 Linux 的首次访问策略落在接收线程所在的 NUMA 节点上；
+/// 空闲缓冲区分散在按线程划分的若干条带中，线程优先在自己的条带上取还，条带为空时再从其他条带成批取走一半，
+/// 之后才申请新块。缓冲区一经申请便不再归还系统，稳定运行后收发不再分配内存。
+class BufferPool
+{
+public:
+    /// @param slab_size 每个缓冲区的数据区字节数
+    /// @param max_slabs 缓冲区总数上限，0 为不限；达到上限后 acquire 返回空
+    /// @param chunk_slabs 每次向系统申请的缓冲区个数
+    explicit BufferPool(size_t slab_size, size_t max_slabs = 0, size_t chunk_slabs = 256);
+    ~BufferPool();
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /// @brief 进程内共用的池，缓冲区不小于 min_size（向上取到 2 的幂，最小 4096），不会被释放
+    static BufferPool &forSize(size_t min_size);
+
+    /// @brief 取一个缓冲区，引用计数为 1；达到上限时返回空
+    PacketSlab *acquire();
+    size_t slabSize() const { return this->dataSize; }
+    BufferPoolStats stats() const;
+
+private:
+    friend struct PacketSlab;
+    static constexpr size_t stripeCount = 16;
+    static size_t threadStripe(); ///< 当前线程使用的条带，线程首次调用时按序分配
+
+    struct alignas(cacheLineSize) Stripe
+    {
+        std::mutex stripeMutex;
+        std::vector<PacketSlab *> freeSlabs;
+    };
+
+    void recycle(PacketSlab *slab); ///< 归还到当前线程的条带
+    PacketSlab *steal(size_t stripe_index); ///< 从其他条带取走一半空闲缓冲区
+    PacketSlab *grow(size_t stripe_index);  ///< 申请一个新块，多余的缓冲区放入当前条带
+
+    size_t dataSize;
+    size_t strideSize; ///< 头部加数据区，按缓存行对齐
+    size_t maxSlabs;
+    size_t chunkSlabs;
+    std::array<Stripe, stripeCount> stripes;
+    std::mutex chunkMutex;
+    std::vector<uint8_t *> chunks;
+    std::atomic<uint64_t> allocated{0};
+    std::atomic<uint64_t> acquired{0};
+    std::atomic<uint64_t> exhausted{0};
+};
+
+/// @brief 持有一个数据包的所有权：引用池化缓冲区，可在回调返回后、其他线程上继续使用，最后一个引用释放时缓冲区回到池中
+/// 由 PacketView 构造：视图带有 slab（套接字接收的数据包）时只增加引用计数，不拷贝；否则拷贝进共用池的缓冲区，
+/// 池达到上限时构造出空引用（operator bool 为 false），使用前需检查
+class PacketRef
+{
+public:
+    PacketRef() = default;
+    explicit PacketRef(const PacketView &packet);
+    PacketRef(const PacketRef &other);
+    PacketRef(PacketRef &&other) noexcept;
+    PacketRef &operator=(PacketRef other) noexcept;
+    ~PacketRef() { this->reset(); }
+
+    void reset();
+    explicit operator bool() const { return this->slab != nullptr; }
+    const uint8_t *data() const { return this->viewData.data; }
+    size_t size() const { return this->viewData.length; }
+    /// 数据包视图，slab 指向同一缓冲区，可再次构造 PacketRef
+    const PacketView &view() const { return this->viewData; }
+
+private:
+    PacketSlab *slab = nullptr;
+    PacketView viewData;
+};
+
+/// @brief 接收循环的一个接收槽位：读之前 prepare() 给出可写的缓冲区，缓冲区被使用者持有时先换上新的，否则原地复用
+class ReceiveSlot
+{
+public:
+    ReceiveSlot() = default; ///< 未指定池，prepare() 之前需赋值
+    explicit ReceiveSlot(BufferPool &buffer_pool) : pool(&buffer_pool) {}
+    ReceiveSlot(const ReceiveSlot &) = delete;
+    ReceiveSlot(ReceiveSlot &&other) noexcept : pool(other.pool), slab(std::exchange(other.slab, nullptr)) {}
+    ReceiveSlot &operator=(ReceiveSlot other) noexcept
+    {
+        std::swap(this->pool, other.pool);
+        std::swap(this->slab, other.slab);
+        return *this;
+    }
+    ~ReceiveSlot()
+    {
+        if (this->slab)
+            this->slab->release();
+    }
+
+    /// @return 可写缓冲区，池达到上限（或未指定池）时返回空
+    uint8_t *prepare()
+    {
+        if (!this->pool)
+            return nullptr;
+        if (this->slab && this->slab->shared())
+        {
+            this->slab->release();
+            this->slab = nullptr;
+        }
+        if (!this->slab)
+            this->slab = this->pool->acquire();
+        return this->slab ? this->slab->data() : nullptr;
+    }
+    uint8_t *data() const { return this->slab ? this->slab->data() : nullptr; }
+    PacketSlab *current() const { return this->slab; }
+    size_t capacity() const { return this->pool ? this->pool->slabSize() : 0; }
+
+private:
+    BufferPool *pool = nullptr;
+    PacketSlab *slab = nullptr;
+};
+#endif
@@ -0,0 +1,314 @@
+#ifndef _PacketRing_hpp_
+#define _PacketRing_hpp_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <thread>
+#include <vector>
+#include "PacketView.hpp"
+
+constexpr size_t cacheLineSize = 64; ///< 缓存行大小，生产者与消费者的位置分开放置避免伪共享
+
+/// @brief 环满时生产者的处理方式
+enum class RingFullPolicy
+{
+    RF_Drop,  ///< 丢弃新包并计数，接收线程永不阻塞
+    RF_Block, ///< 自旋/让出等待消费者腾出槽位并计数，压力回传给内核套接字缓冲区
+};
+
+/// @brief 环形队列计数快照
+struct PacketRingStats
+{
+    uint64_t pushed = 0;       ///< 成功入队
+    uint64_t popped = 0;       ///< 已被消费
+    uint64_t dropped = 0;      ///< 环满丢弃
+    uint64_t oversized = 0;    ///< 超过最大包长丢弃
+    uint64_t spilled = 0;      ///< 超过槽位大小、拷贝到槽位附带的堆缓冲区
+    uint64_t backpressure = 0; ///< 环满等待的次数
+};
+
+/// @brief 有界无锁数据包环形队列，槽位在构造时一次性分配
+/// MultiProducer 为 false 时是 SPSC（单个接收线程），为 true 时是 MPSC（多个套接字的接收线程共用），消费者始终只有一个。
+/// push 把数据拷贝进槽位后立即返回，接收线程不再等待解析；consume 在槽位上原地回调，回调返回后槽位才被复用。
+/// 超过槽位大小（但不超过 max_packet_size）的包拷贝到该槽位自带的堆缓冲区，缓冲区只增不减，之后同样大小的包不再分配。
+template <bool MultiProducer>
+class PacketRing
+{
+public:
+    /// @param slot_size 槽位内联数据区大小，常见包长应在此之内
+    /// @param max_packet_size 可入队的最大包长，0 表示等于 slot_size；更大的包计入 oversized 并丢弃
+    PacketRing(size_t slot_count, size_t slot_size, RingFullPolicy full_policy = RingFullPolicy::RF_Drop, size_t max_packet_size = 0)
+        : slotSize(slot_size), maxPacket(std::max(slot_size, max_packet_size)), fullPolicy(full_policy)
+    {
+        size_t capacity = 2;
+        while (capacity < slot_count)
+            capacity <<= 1;
+        this->mask = capacity - 1;
+        this->storage.resize(capacity * slot_size);
+        this->slots = std::vector<Slot>(capacity);
+        for (size_t i = 0; i < capacity; i++)
+            this->slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    PacketRing(const PacketRing &) = delete;
+    PacketRing &operator=(const PacketRing &) = delete;
+
+    /// @brief 拷贝一个数据包入队
+    /// @return 入队失败（环满丢弃或超过槽位大小）时返回 false
+    bool push(const PacketView &packet)
+    {
+        if (packet.length > this->maxPacket)
+        {
+            this->counters.oversized.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        uint64_t pos;
+        while (!this->claim(pos))
+        {
+            if (this->fullPolicy == RingFullPolicy::RF_Drop)
+            {
+                this->counters.dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            this->counters.backpressure.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+        auto &slot = this->slots[pos & this->mask];
+        auto *dest = this->slotData(pos);
+        if (packet.length > this->slotSize)
+        {
+            // 生产者在 claim 之后、publish 之前独占该槽位
+            if (slot.spill.size() < packet.length)
+                slot.spill.resize(packet.length);
+            dest = slot.spill.data();
+            this->counters.spilled.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::memcpy(dest, packet.data, packet.length);
+        slot.length = packet.length;
+        slot.source.ip.assign(packet.source.ip); // IPv4 地址在 SSO 范围内，不分配
+        slot.source.port = packet.source.port;
+        slot.recvTime = packet.recvTime;
+        slot.streamId = packet.streamId;
+        this->publish(pos);
+        this->counters.pushed.fetch_add(1, std::memory_order_relaxed);
+        this->notifyConsumer();
+        return true;
+    }
+
+    /// @brief 消费最多 max_count 个数据包，只能由唯一的消费线程调用
+    /// @return 实际消费的个数
+    template <typename Func>
+    size_t consume(Func &&func, size_t max_count = SIZE_MAX)
+    {
+        size_t count = 0;
+        while (count < max_count)
+        {
+            auto pos = this->head.value.load(std::memory_order_relaxed);
+            auto &slot = this->slots[pos & this->mask];
+            if (!this->readable(pos))
+                break;
+            auto *data = slot.length > this->slotSize ? slot.spill.data() : this->slotData(pos);
+            func(PacketView(data, slot.length, slot.source, slot.recvTime, slot.streamId));
+            slot.sequence.store(pos + this->mask + 1, std::memory_order_release);
+            this->head.value.store(pos + 1, std::memory_order_release);
+            count++;
+        }
+        if (count)
+            this->counters.popped.fetch_add(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    /// @brief 消费者在队列为空时调用：先登记休眠再检查一次，仍为空且 keep_waiting 为真时阻塞（futex），
+    /// 直到生产者入队或 wake()；只能由唯一的消费线程调用
+    void waitForData(const std::atomic<bool> &keep_waiting)
+    {
+        this->sleeping.store(1, std::memory_order_relaxed);
+        // 与 notifyConsumer/wake 中的栅栏配对：要么生产者看到休眠标志，要么这里看到新数据或退出请求
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!this->readable(this->head.value.load(std::memory_order_relaxed)) && keep_waiting.load(std::memory_order_relaxed))
+            this->sleeping.wait(1, std::memory_order_relaxed);
+        this->sleeping.store(0, std::memory_order_relaxed);
+    }
+
+    /// @brief 唤醒在 waitForData 中休眠的消费者，用于修改 keep_waiting 之后
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        this->sleeping.store(0, std::memory_order_relaxed);
+        this->sleeping.notify_one();
+    }
+
+    size_t capacity() const { return this->mask + 1; }
+    size_t size() const
+    {
+        return this->tail.value.load(std::memory_order_acquire) - this->head.value.load(std::memory_order_acquire);
+    }
+
+    PacketRingStats stats() const
+    {
+        PacketRingStats res;
+        res.pushed = this->counters.pushed.load(std::memory_order_relaxed);
+        res.popped = this->counters.popped.load(std::memory_order_relaxed);
+        res.dropped = this->counters.dropped.load(std::memory_order_relaxed);
+        res.oversized = this->counters.oversized.load(std::memory_order_relaxed);
+        res.spilled = this->counters.spilled.load(std::memory_order_relaxed);
+        res.backpressure = this->counters.backpressure.load(std::memory_order_relaxed);
+        return res;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0}; ///< 等于位置时可写，等于位置+1 时可读
+        size_t length = 0;
+        AddrInfo source;
+        PacketView::Clock::time_point recvTime;
+        uint64_t streamId = 0;
+        std::vector<uint8_t> spill; ///< 超过 slotSize 的包的数据区
+    };
+
+    struct alignas(cacheLineSize) PaddedIndex
+    {
+        std::atomic<uint64_t> value{0};
+    };
+
+    struct Counters
+    {
+        alignas(cacheLineSize) std::atomic<uint64_t> pushed{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> oversized{0};
+        std::atomic<uint64_t> spilled{0};
+        std::atomic<uint64_t> backpressure{0};
+        alignas(cacheLineSize) std::atomic<uint64_t> popped{0};
+    };
+
+    uint8_t *slotData(uint64_t pos) { return this->storage.data() + (pos & this->mask) * this->slotSize; }
+
+    // 申请一个可写位置，环满返回 false
+    bool claim(uint64_t &pos)
+    {
+        if constexpr (!MultiProducer)
+        {
+            // SPSC：只有本线程写 tail，先看缓存的 head，不够时才读取共享的 head
+            pos = this->tail.value.load(std::memory_order_relaxed);
+            if (pos - this->cachedHead > this->mask)
+            {
+                this->cachedHead = this->head.value.load(std::memory_order_acquire);
+                if (pos - this->cachedHead > this->mask)
+                    return false;
+            }
+            return true;
+        }
+        else
+        {
+            // MPSC：按槽位序号判断可写，再用 CAS 抢占位置
+            pos = this->tail.value.load(std::memory_order_relaxed);
+            while (true)
+            {
+                auto seq = this->slots[pos & this->mask].sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+                if (diff == 0)
+                {
+                    if (this->tail.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        return true;
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = this->tail.value.load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    bool readable(uint64_t pos) const
+    {
+        return this->slots[pos & this->mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    // 消费者休眠时由入队的生产者唤醒；未休眠时只多一次栅栏与一次读
+    void notifyConsumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (this->sleeping.load(std::memory_order_relaxed) && this->sleeping.exchange(0, std::memory_order_relaxed))
+            this->sleeping.notify_one();
+    }
+
+    void publish(uint64_t pos)
+    {
+        this->slots[pos & this->mask].sequence.store(pos + 1, std::memory_order_release);
+        if constexpr (!MultiProducer)
+            this->tail.value.store(pos + 1, std::memory_order_release);
+    }
+
+    size_t slotSize;
+    size_t maxPacket;
+    size_t mask = 0;
+    RingFullPolicy fullPolicy;
+    std::vector<uint8_t> storage; ///< 所有槽位的数据区
+    std::vector<Slot> slots;
+    PaddedIndex tail;                       ///< 生产位置
+    PaddedIndex head;                       ///< 消费位置
+    alignas(cacheLineSize) uint64_t cachedHead = 0; ///< SPSC 生产者缓存的消费位置
+    alignas(cacheLineSize) std::atomic<uint32_t> sleeping{0}; ///< 消费者在 waitForData 中休眠时为 1，作为 futex 字
+    Counters counters;
+};
+
+using SpscPacketRing = PacketRing<false>;
+using MpscPacketRing = PacketRing<true>;
+
+/// @brief 环形队列的消费线程，把队列中的数据包交给回调（通常是 ProtocolManager::parse）
+/// 队列为空时先自旋，再让出，之后在队列上休眠（futex）直到生产者入队，空闲时不占用 CPU 也不周期唤醒。
+template <typename Ring>
+class RingWorker
+{
+public:
+    RingWorker(Ring &ring, std::function<void(const PacketView &packet)> packet_callback, size_t batch_size = 64)
+        : ring(ring), packetCallback(std::move(packet_callback)), batchSize(batch_size)
+    {
+        this->workThread = std::thread([this]()
+                                       {
+            int idleRounds = 0;
+            while (this->running.load(std::memory_order_relaxed))
+            {
+                if (this->ring.consume(this->packetCallback, this->batchSize) > 0)
+                {
+                    idleRounds = 0;
+                    continue;
+                }
+                if (++idleRounds < 64)
+                    continue;
+                else if (idleRounds < 128)
+                    std::this_thread::yield();
+                else
+                {
+                    this->ring.waitForData(this->running);
+                    idleRounds = 0;
+                }
+            }
+            this->ring.consume(this->packetCallback); });
+    }
+    ~RingWorker()
+    {
+        this->running = false;
+        this->ring.wake();
+        if (this->workThread.joinable())
+            this->workThread.join();
+    }
+    RingWorker(const RingWorker &) = delete;
+    RingWorker &operator=(const RingWorker &) = delete;
+
+private:
+    Ring &ring;
+    std::function<void(const PacketView &packet)> packetCallback;
+    size_t batchSize;
+    std::atomic<bool> running{true};
+    std::thread workThread;
+};
+#endif
@@ -0,0 +1,40 @@
+#ifndef _PacketView_hpp_
+#define _PacketView_hpp_
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+struct PacketSlab;
+
+/// @brief 对端地址信息
+struct AddrInfo
+{
+    std::string ip;
+    int port = 0;
+};
+
+/// @brief 非拥有的数据包视图，指向接收缓冲区，仅在回调期间有效；需要保留数据的使用者构造 PacketRef（见 PacketBuffer.hpp）
+struct PacketView
+{
+    using Clock = std::chrono::system_clock;
+
+    const uint8_t *data = nullptr; ///< 数据起始地址
+    size_t length = 0;             ///< 数据长度
+    AddrInfo source;               ///< 来源地址
+    Clock::time_point recvTime;    ///< 接收时间戳
+    uint64_t streamId = 0;         ///< 流标识，TCP 服务端为连接ID，其余为 0
+    PacketSlab *slab = nullptr;    ///< 数据所在的池化缓冲区，套接字接收的数据包才有；用 PacketRef 持有可延长数据的生命周期
+
+    PacketView() = default;
+    PacketView(const void *buffer, size_t buffer_length, const AddrInfo &addr_info = {}, Clock::time_point recv_time = {}, uint64_t stream_id = 0)
+        : data(static_cast<const uint8_t *>(buffer)), length(buffer_length), source(addr_info), recvTime(recv_time), streamId(stream_id) {}
+    PacketView(std::string_view buffer, const AddrInfo &addr_info = {}, Clock::time_point recv_time = {}, uint64_t stream_id = 0)
+        : PacketView(buffer.data(), buffer.size(), addr_info, recv_time, stream_id) {}
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    std::string_view str() const { return {reinterpret_cast<const char *>(data), length}; }
+};
+#endif
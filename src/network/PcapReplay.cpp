@@ -0,0 +1,508 @@
+#include "PcapReplay.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr uint32_t pcapMagicMicro = 0xA1B2C3D4;  ///< pcap，微秒时间戳
+    constexpr uint32_t pcapMagicNano = 0xA1B23C4D;   ///< pcap，纳秒时间戳
+    constexpr size_t pcapFileHeaderSize = 24;
+    constexpr size_t pcapRecordHeaderSize = 16;
+
+    constexpr uint32_t pcapngSectionHeader = 0x0A0D0D0A; ///< 字节序对称，任意字节序下读出的值相同
+    constexpr uint32_t pcapngByteOrder = 0x1A2B3C4D;
+    constexpr uint32_t pcapngInterface = 1;
+    constexpr uint32_t pcapngSimplePacket = 3;
+    constexpr uint32_t pcapngEnhancedPacket = 6;
+    constexpr uint16_t pcapngOptionTsResol = 9;
+
+    // 链路层类型（LINKTYPE_*）
+    constexpr uint16_t linkNull = 0;         ///< BSD loopback，4 字节协议族，按文件字节序
+    constexpr uint16_t linkEthernet = 1;
+    constexpr uint16_t linkRaw = 101;        ///< 直接是 IPv4/IPv6 包
+    constexpr uint16_t linkLinuxSll = 113;
+    constexpr uint16_t linkIpv4 = 228;
+    constexpr uint16_t linkIpv6 = 229;
+    constexpr uint16_t linkLinuxSll2 = 276;
+
+    constexpr uint16_t etherIpv4 = 0x0800;
+    constexpr uint16_t etherIpv6 = 0x86DD;
+    constexpr uint8_t protoTcp = 6;
+    constexpr uint8_t protoUdp = 17;
+
+    // 协议头部字段始终是网络字节序，与抓包文件的字节序无关
+    uint16_t be16(const uint8_t *src)
+    {
+        uint16_t val;
+        std::memcpy(&val, src, sizeof(val));
+        return ntohs(val);
+    }
+
+    uint32_t raw32(const uint8_t *src)
+    {
+        uint32_t val;
+        std::memcpy(&val, src, sizeof(val));
+        return val;
+    }
+
+    // TCP 每个方向是一条独立的字节流，按有向四元组散列
+    uint64_t flowHash(const uint8_t *src_addr, const uint8_t *dst_addr, size_t addr_length, uint16_t src_port, uint16_t dst_port)
+    {
+        uint64_t key = 0xCBF29CE484222325ull;
+        auto mix = [&key](const uint8_t *bytes, size_t length)
+        {
+            for (size_t i = 0; i < length; i++)
+                key = (key ^ bytes[i]) * 0x100000001B3ull;
+        };
+        mix(src_addr, addr_length);
+        mix(dst_addr, addr_length);
+        uint8_t ports[4] = {uint8_t(src_port >> 8), uint8_t(src_port), uint8_t(dst_port >> 8), uint8_t(dst_port)};
+        mix(ports, sizeof(ports));
+        return key ? key : 1;
+    }
+}
+
+PcapReplay::~PcapReplay()
+{
+    this->close();
+}
+
+bool PcapReplay::open(const std::string &path)
+{
+    this->close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "打开抓包文件失败: " << path << ", errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0 || fileStat.st_size < static_cast<off_t>(pcapFileHeaderSize))
+    {
+        std::cerr << "抓包文件为空或过短: " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void *base = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // 映射建立后不再需要 fd
+    if (base == MAP_FAILED)
+    {
+        std::cerr << "映射抓包文件失败: " << path << ", errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+    madvise(base, fileStat.st_size, MADV_SEQUENTIAL);
+    this->mapBase = static_cast<const uint8_t *>(base);
+    this->mapLength = static_cast<size_t>(fileStat.st_size);
+
+    auto magic = raw32(this->mapBase);
+    if (magic == pcapMagicMicro || magic == pcapMagicNano ||
+        magic == __builtin_bswap32(pcapMagicMicro) || magic == __builtin_bswap32(pcapMagicNano))
+    {
+        this->pcapng = false;
+        this->swapped = magic != pcapMagicMicro && magic != pcapMagicNano;
+        bool nano = magic == pcapMagicNano || magic == __builtin_bswap32(pcapMagicNano);
+        Interface t_interface;
+        t_interface.linkType = static_cast<uint16_t>(this->read32(this->mapBase + 20)); // 高位是 FCS 信息
+        t_interface.tsUnitsPerSecond = nano ? 1000000000 : 1000000;
+        this->interfaces = {t_interface};
+        this->dataBegin = pcapFileHeaderSize;
+        return true;
+    }
+    auto order = raw32(this->mapBase + 8);
+    if (magic == pcapngSectionHeader && (order == pcapngByteOrder || order == __builtin_bswap32(pcapngByteOrder)))
+    {
+        // 字节序与接口表在遇到每个 SHB 时重新设定
+        this->pcapng = true;
+        this->dataBegin = 0;
+        return true;
+    }
+    std::cerr << "不支持的抓包文件格式: " << path << std::endl;
+    this->close();
+    return false;
+}
+
+void PcapReplay::close()
+{
+    if (this->mapBase)
+        munmap(const_cast<uint8_t *>(this->mapBase), this->mapLength);
+    this->mapBase = nullptr;
+    this->mapLength = 0;
+    this->interfaces.clear();
+}
+
+uint16_t PcapReplay::read16(const uint8_t *src) const
+{
+    uint16_t val;
+    std::memcpy(&val, src, sizeof(val));
+    return this->swapped ? __builtin_bswap16(val) : val;
+}
+
+uint32_t PcapReplay::read32(const uint8_t *src) const
+{
+    auto val = raw32(src);
+    return this->swapped ? __builtin_bswap32(val) : val;
+}
+
+bool PcapReplay::nextRecord(size_t &pos, Record &record)
+{
+    if (this->pcapng)
+        return this->nextPcapngRecord(pos, record);
+    if (pos + pcapRecordHeaderSize > this->mapLength)
+        return false;
+    const uint8_t *header = this->mapBase + pos;
+    auto capLength = this->read32(header + 8);
+    if (pos + pcapRecordHeaderSize + capLength > this->mapLength)
+        return false; // 文件尾部被截断
+    record.data = header + pcapRecordHeaderSize;
+    record.capLength = capLength;
+    record.origLength = this->read32(header + 12);
+    record.interfaceId = 0;
+    record.timestamp = uint64_t(this->read32(header)) * this->interfaces[0].tsUnitsPerSecond + this->read32(header + 4);
+    pos += pcapRecordHeaderSize + capLength;
+    return true;
+}
+
+bool PcapReplay::nextPcapngRecord(size_t &pos, Record &record)
+{
+    while (pos + 12 <= this->mapLength)
+    {
+        const uint8_t *block = this->mapBase + pos;
+        if (raw32(block) == pcapngSectionHeader)
+        {
+            auto order = raw32(block + 8);
+            if (order != pcapngByteOrder && order != __builtin_bswap32(pcapngByteOrder))
+                return false;
+            this->swapped = order != pcapngByteOrder;
+            this->interfaces.clear();
+        }
+        auto type = this->read32(block);
+        auto length = this->read32(block + 4);
+        if (length < 12 || length % 4 || pos + length > this->mapLength)
+            return false; // 块损坏，无法继续定位下一个块
+        pos += length;
+
+        if (type == pcapngInterface && length >= 20)
+        {
+            Interface t_interface;
+            t_interface.linkType = this->read16(block + 8);
+            // 选项：code(2) length(2) value（补齐到 4 字节），code 0 结束
+            for (size_t t_opt = 16; t_opt + 4 <= length - 4;)
+            {
+                auto t_code = this->read16(block + t_opt);
+                auto t_length = this->read16(block + t_opt + 2);
+                if (t_code == 0 || t_opt + 4 + t_length > length - 4)
+                    break;
+                if (t_code == pcapngOptionTsResol && t_length >= 1)
+                {
+                    auto t_resol = block[t_opt + 4];
+                    uint64_t t_units = 1;
+                    if (t_resol & 0x80)
+                        t_units = uint64_t(1) << std::min(t_resol & 0x7F, 63);
+                    else
+                        for (int i = 0; i < std::min<int>(t_resol, 19); i++)
+                            t_units *= 10;
+                    t_interface.tsUnitsPerSecond = t_units;
+                }
+                t_opt += 4 + ((t_length + 3u) & ~3u);
+            }
+            this->interfaces.push_back(t_interface);
+        }
+        else if (type == pcapngEnhancedPacket && length >= 32)
+        {
+            auto capLength = this->read32(block + 20);
+            if (28 + size_t(capLength) > length - 4)
+                continue;
+            record.interfaceId = this->read32(block + 8);
+            record.timestamp = (uint64_t(this->read32(block + 12)) << 32) | this->read32(block + 16);
+            record.capLength = capLength;
+            record.origLength = this->read32(block + 24);
+            record.data = block + 28;
+            return true;
+        }
+        else if (type == pcapngSimplePacket && length >= 16)
+        {
+            // SPB 没有时间戳，属于第一个接口
+            record.interfaceId = 0;
+            record.timestamp = 0;
+            record.origLength = this->read32(block + 8);
+            record.capLength = std::min<size_t>(record.origLength, length - 16);
+            record.data = block + 12;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PcapReplay::decode(const Record &record, const ReplayOptions &options, PacketView &packet, ReplayStats &stats) const
+{
+    if (record.interfaceId >= this->interfaces.size())
+    {
+        stats.truncated++;
+        return false;
+    }
+    const auto &interface = this->interfaces[record.interfaceId];
+    const uint8_t *pos = record.data;
+    size_t length = record.capLength;
+
+    // 链路层
+    uint16_t etherType = 0;
+    switch (interface.linkType)
+    {
+    case linkEthernet:
+        if (length < 14)
+        {
+            stats.truncated++;
+            return false;
+        }
+        etherType = be16(pos + 12);
+        pos += 14;
+        length -= 14;
+        while ((etherType == 0x8100 || etherType == 0x88A8) && length >= 4) // VLAN / QinQ
+        {
+            etherType = be16(pos + 2);
+            pos += 4;
+            length -= 4;
+        }
+        break;
+    case linkLinuxSll:
+        if (length < 16)
+        {
+            stats.truncated++;
+            return false;
+        }
+        etherType = be16(pos + 14);
+        pos += 16;
+        length -= 16;
+        break;
+    case linkLinuxSll2:
+        if (length < 20)
+        {
+            stats.truncated++;
+            return false;
+        }
+        etherType = be16(pos);
+        pos += 20;
+        length -= 20;
+        break;
+    case linkRaw:
+    case linkIpv4:
+    case linkIpv6:
+        if (length < 1)
+        {
+            stats.truncated++;
+            return false;
+        }
+        etherType = (pos[0] >> 4) == 6 ? etherIpv6 : etherIpv4;
+        break;
+    case linkNull:
+    {
+        if (length < 4)
+        {
+            stats.truncated++;
+            return false;
+        }
+        auto family = this->read32(pos);
+        etherType = family == AF_INET ? etherIpv4 : (family == 24 || family == 28 || family == 30) ? etherIpv6 : 0; // 各 BSD 的 AF_INET6
+        pos += 4;
+        length -= 4;
+        break;
+    }
+    default:
+        stats.skipped++;
+        return false;
+    }
+
+    // 网络层
+    uint8_t protocol = 0;
+    const uint8_t *srcAddr = nullptr, *dstAddr = nullptr;
+    size_t addrLength = 0;
+    if (etherType == etherIpv4)
+    {
+        size_t headerLength = length >= 20 ? (pos[0] & 0x0F) * 4u : 0;
+        size_t totalLength = length >= 20 ? be16(pos + 2) : 0;
+        if (headerLength < 20 || totalLength < headerLength || totalLength > length)
+        {
+            stats.truncated++;
+            return false;
+        }
+        if (be16(pos + 6) & 0x3FFF) // MF 或片偏移非 0
+        {
+            stats.fragments++;
+            return false;
+        }
+        protocol = pos[9];
+        srcAddr = pos + 12;
+        dstAddr = pos + 16;
+        addrLength = 4;
+        length = totalLength - headerLength; // 去掉以太网尾部填充
+        pos += headerLength;
+    }
+    else if (etherType == etherIpv6)
+    {
+        size_t payloadLength = length >= 40 ? be16(pos + 4) : 0;
+        if (length < 40 || payloadLength == 0 || 40 + payloadLength > length)
+        {
+            stats.truncated++;
+            return false;
+        }
+        protocol = pos[6];
+        srcAddr = pos + 8;
+        dstAddr = pos + 24;
+        addrLength = 16;
+        pos += 40;
+        length = payloadLength;
+        while (protocol == 0 || protocol == 43 || protocol == 60) // 逐跳、路由、目的选项扩展头
+        {
+            size_t t_length = length >= 8 ? (pos[1] + 1u) * 8 : 0;
+            if (t_length == 0 || t_length > length)
+            {
+                stats.truncated++;
+                return false;
+            }
+            protocol = pos[0];
+            pos += t_length;
+            length -= t_length;
+        }
+        if (protocol == 44)
+        {
+            stats.fragments++;
+            return false;
+        }
+    }
+    else
+    {
+        stats.skipped++;
+        return false;
+    }
+
+    // 传输层
+    uint16_t srcPort = 0, dstPort = 0;
+    const uint8_t *payload = nullptr;
+    size_t payloadLength = 0;
+    if (protocol == protoUdp && options.udp)
+    {
+        size_t udpLength = length >= 8 ? be16(pos + 4) : 0;
+        if (udpLength < 8 || udpLength > length)
+        {
+            stats.truncated++;
+            return false;
+        }
+        srcPort = be16(pos);
+        dstPort = be16(pos + 2);
+        payload = pos + 8;
+        payloadLength = udpLength - 8;
+        packet.streamId = 0;
+    }
+    else if (protocol == protoTcp && options.tcp)
+    {
+        size_t headerLength = length >= 20 ? (pos[12] >> 4) * 4u : 0;
+        if (headerLength < 20 || headerLength > length)
+        {
+            stats.truncated++;
+            return false;
+        }
+        srcPort = be16(pos);
+        dstPort = be16(pos + 2);
+        payload = pos + headerLength;
+        payloadLength = length - headerLength;
+        packet.streamId = flowHash(srcAddr, dstAddr, addrLength, srcPort, dstPort);
+    }
+    if (!payload || payloadLength == 0 || (options.port && srcPort != options.port && dstPort != options.port))
+    {
+        stats.skipped++;
+        return false;
+    }
+
+    char ipStr[INET6_ADDRSTRLEN];
+    inet_ntop(addrLength == 4 ? AF_INET : AF_INET6, srcAddr, ipStr, sizeof(ipStr));
+    packet.source.ip = ipStr; // 复用已有容量，IPv4 地址在短字符串优化范围内
+    packet.source.port = srcPort;
+    packet.data = payload;
+    packet.length = payloadLength;
+
+    // 时间戳换算成纳秒，分数部分用 128 位避免溢出
+    auto units = interface.tsUnitsPerSecond;
+    auto nanos = (record.timestamp / units) * 1000000000ull +
+                 static_cast<uint64_t>(static_cast<unsigned __int128>(record.timestamp % units) * 1000000000ull / units);
+    packet.recvTime = PacketView::Clock::time_point(std::chrono::duration_cast<PacketView::Clock::duration>(std::chrono::nanoseconds(nanos)));
+    return true;
+}
+
+ReplayStats PcapReplay::replay(ReplayBatchCallback batchCallback, const ReplayOptions &options)
+{
+    using SteadyClock = std::chrono::steady_clock;
+    ReplayStats stats;
+    if (!this->isOpen() || !batchCallback)
+        return stats;
+    this->stopFlag = false;
+
+    std::vector<PacketView> batch(std::max<size_t>(options.batchSize, 1));
+    size_t count = 0;
+    bool paced = options.pacing == ReplayPacing::RP_Original && options.speed > 0;
+    for (size_t loop = 0; (options.loops == 0 || loop < options.loops) && !this->stopFlag; loop++)
+    {
+        size_t pos = this->dataBegin;
+        Record record;
+        bool started = false;
+        PacketView::Clock::time_point firstTime;
+        SteadyClock::time_point startTime;
+        while (!this->stopFlag && this->nextRecord(pos, record))
+        {
+            stats.records++;
+            if (!this->decode(record, options, batch[count], stats))
+                continue;
+            if (paced)
+            {
+                if (!started)
+                {
+                    firstTime = batch[count].recvTime;
+                    startTime = SteadyClock::now();
+                    started = true;
+                }
+                auto due = startTime + std::chrono::duration_cast<SteadyClock::duration>((batch[count].recvTime - firstTime) / options.speed);
+                if (due > SteadyClock::now())
+                {
+                    // 先交出已攒下的包，它们不应被推迟
+                    if (count > 0)
+                    {
+                        batchCallback(batch.data(), count);
+                        std::swap(batch[0], batch[count]);
+                        count = 0;
+                    }
+                    // 分段等待，长间隔中也能响应 stop()
+                    while (!this->stopFlag && due > SteadyClock::now())
+                        std::this_thread::sleep_until(std::min(due, SteadyClock::now() + std::chrono::milliseconds(100)));
+                }
+            }
+            stats.packets++;
+            stats.bytes += batch[count].length;
+            if (++count == batch.size())
+            {
+                batchCallback(batch.data(), count);
+                count = 0;
+            }
+        }
+    }
+    if (count > 0)
+        batchCallback(batch.data(), count);
+    return stats;
+}
+
+ReplayStats PcapReplay::replay(std::function<void(const PacketView &packet)> recvCallback, const ReplayOptions &options)
+{
+    if (!recvCallback)
+        return {};
+    return this->replay([&recvCallback](const PacketView *packets, size_t count)
+                        {
+        for (size_t i = 0; i < count; i++)
+            recvCallback(packets[i]); }, options);
+}
@@ -0,0 +1,103 @@
+#ifndef _PcapReplay_hpp_
+#define _PcapReplay_hpp_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "PacketView.hpp"
+
+/// @brief 回放节奏
+enum class ReplayPacing : uint8_t
+{
+    RP_MaxSpeed, ///< 尽快回放，不等待
+    RP_Original, ///< 按抓包时间戳的间隔回放（可按 speed 倍速）
+};
+
+/// @brief 回放选项
+struct ReplayOptions
+{
+    ReplayPacing pacing = ReplayPacing::RP_MaxSpeed;
+    double speed = 1.0;    ///< RP_Original 的倍速，2.0 表示两倍速
+    bool udp = true;       ///< 回放 UDP 负载
+    bool tcp = true;       ///< 回放 TCP 负载（只取非空段，不做重组与去重）
+    uint16_t port = 0;     ///< 只回放源或目的端口为该值的包，0 不过滤
+    size_t batchSize = 64; ///< 批量回调每批最多的数据包数
+    size_t loops = 1;      ///< 回放遍数，0 表示直到 stop()
+};
+
+/// @brief 回放统计
+struct ReplayStats
+{
+    uint64_t records = 0;   ///< 读到的抓包记录数
+    uint64_t packets = 0;   ///< 交给回调的数据包数
+    uint64_t bytes = 0;     ///< 交给回调的负载字节数
+    uint64_t skipped = 0;   ///< 非 IP、非 UDP/TCP、空负载或被过滤掉的记录
+    uint64_t truncated = 0; ///< 抓包长度不足或头部不合法的记录
+    uint64_t fragments = 0; ///< IP 分片（不重组，跳过）
+};
+
+/// 批量回放回调，packets 在回调返回前有效
+using ReplayBatchCallback = std::function<void(const PacketView *packets, size_t count)>;
+
+/// @brief 抓包文件回放：把 pcap/pcapng 文件只读映射到内存，逐条记录解析以太网/IP/UDP/TCP 头部，
+/// 以指向映射内存的 PacketView 交给回调（不拷贝负载），可直接接到 ProtocolManager::parseBatch。
+/// 支持 pcap（微秒/纳秒、两种字节序）与 pcapng（SHB/IDB/EPB/SPB，多接口与 if_tsresol），
+/// 链路层支持以太网（含 VLAN）、Linux cooked（SLL/SLL2）、Raw IP 与 BSD loopback。
+/// PacketView 的 recvTime 为抓包时间戳，source 为源地址；TCP 的 streamId 为四元组散列（非 0），UDP 为 0。
+class PcapReplay
+{
+public:
+    PcapReplay() = default;
+    explicit PcapReplay(const std::string &path) { open(path); }
+    ~PcapReplay();
+    PcapReplay(const PcapReplay &) = delete;
+    PcapReplay &operator=(const PcapReplay &) = delete;
+
+    /// @brief 映射抓包文件并检查文件头
+    /// @return 文件无法打开或不是 pcap/pcapng 时返回 false
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return mapBase != nullptr; }
+
+    /// @brief 在调用线程上回放整个文件，按 options.batchSize 分批回调
+    /// @return 本次回放的统计
+    ReplayStats replay(ReplayBatchCallback batchCallback, const ReplayOptions &options = {});
+    /// @brief 同上，逐包回调
+    ReplayStats replay(std::function<void(const PacketView &packet)> recvCallback, const ReplayOptions &options = {});
+    /// 让正在进行的 replay 在当前批次后返回，可在其他线程或回调中调用
+    void stop() { stopFlag = true; }
+
+private:
+    struct Interface
+    {
+        uint16_t linkType = 0;
+        uint64_t tsUnitsPerSecond = 1000000; ///< 时间戳单位，pcapng 由 if_tsresol 指定
+    };
+
+    struct Record
+    {
+        const uint8_t *data = nullptr;
+        size_t capLength = 0;
+        size_t origLength = 0;
+        uint32_t interfaceId = 0;
+        uint64_t timestamp = 0; ///< 以所属接口的时间戳单位计
+    };
+
+    bool nextRecord(size_t &pos, Record &record);        ///< 从 pos 读下一条记录，文件结束返回 false
+    bool nextPcapngRecord(size_t &pos, Record &record);
+    /// 解析链路层到传输层，成功时填写 packet 的负载、地址与流标识
+    bool decode(const Record &record, const ReplayOptions &options, PacketView &packet, ReplayStats &stats) const;
+    uint16_t read16(const uint8_t *src) const;
+    uint32_t read32(const uint8_t *src) const;
+
+    const uint8_t *mapBase = nullptr;
+    size_t mapLength = 0;
+    bool pcapng = false;
+    bool swapped = false;    ///< 文件字节序与主机相反
+    size_t dataBegin = 0;    ///< 第一条记录的位置
+    std::vector<Interface> interfaces;
+    std::atomic<bool> stopFlag{false};
+};
+#endif
@@ -0,0 +1,114 @@
+#include "SendQueue.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+
+SendQueue::SendQueue(size_t max_messages, std::chrono::microseconds max_delay)
+    : maxMessages(max_messages > 0 ? max_messages : 1), maxDelay(max_delay)
+{
+    this->offsets.reserve(this->maxMessages);
+    this->headers.reserve(this->maxMessages);
+    this->iovecs.reserve(this->maxMessages);
+    this->dests.reserve(this->maxMessages);
+}
+
+bool SendQueue::resolve(const std::string &ip, uint16_t port, sockaddr_in &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) == 1;
+}
+
+void SendQueue::push(const void *data, size_t length, const sockaddr_in &dest_addr)
+{
+    if (this->count == 0)
+        this->firstPushTime = Clock::now();
+    if (this->usedBytes + length > this->storage.size())
+        this->storage.resize(std::max(this->storage.size() * 2, this->usedBytes + length));
+    memcpy(this->storage.data() + this->usedBytes, data, length);
+
+    if (this->count == this->headers.size())
+    {
+        this->offsets.emplace_back();
+        this->headers.emplace_back();
+        this->iovecs.emplace_back();
+        this->dests.emplace_back();
+    }
+    this->offsets[this->count] = this->usedBytes;
+    this->iovecs[this->count].iov_len = length;
+    this->dests[this->count] = dest_addr;
+    this->usedBytes += length;
+    this->count++;
+}
+
+bool SendQueue::due(Clock::time_point now) const
+{
+    return this->count > 0 && now - this->firstPushTime >= this->maxDelay;
+}
+
+void SendQueue::setThreshold(size_t max_messages, std::chrono::microseconds max_delay)
+{
+    this->maxMessages = max_messages > 0 ? max_messages : 1;
+    this->maxDelay = max_delay;
+}
+
+int SendQueue::flush(int socket_fd)
+{
+    if (this->count == 0)
+        return 0;
+    // storage 可能在入队过程中扩容，发送前统一填入缓冲区地址
+    for (size_t i = 0; i < this->count; i++)
+    {
+        this->iovecs[i].iov_base = this->storage.data() + this->offsets[i];
+        auto &t_hdr = this->headers[i].msg_hdr;
+        t_hdr = {};
+        t_hdr.msg_iov = &this->iovecs[i];
+        t_hdr.msg_iovlen = 1;
+        t_hdr.msg_name = &this->dests[i];
+        t_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+
+    // sendmmsg 只在第一条就失败时返回 -1，此时 errno 属于 headers[next] 这一条
+    size_t next = 0;
+    size_t sent = 0;
+    int sendErrno = 0;
+    this->droppedCount = 0;
+    this->sentBytes = 0;
+    while (next < this->count)
+    {
+        int sendCount = sendmmsg(socket_fd, this->headers.data() + next, this->count - next, 0);
+        if (sendCount < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            sendErrno = errno;
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                break; // 发送缓冲区已满，剩余的留待下次
+            next++;
+            this->droppedCount++;
+            continue;
+        }
+        for (int i = 0; i < sendCount; i++)
+            this->sentBytes += this->headers[next + i].msg_len;
+        next += sendCount;
+        sent += sendCount;
+    }
+    // 未发出的数据报移到队列头部，数据仍留在 storage 原处
+    for (size_t i = next; i < this->count; i++)
+    {
+        this->offsets[i - next] = this->offsets[i];
+        this->iovecs[i - next].iov_len = this->iovecs[i].iov_len;
+        this->dests[i - next] = this->dests[i];
+    }
+    this->count -= next;
+    if (this->count == 0)
+        this->usedBytes = 0;
+    if (sent == 0 && sendErrno != 0)
+    {
+        errno = sendErrno;
+        return -1;
+    }
+    return static_cast<int>(sent);
+}
@@ -0,0 +1,53 @@
+#ifndef _SendQueue_hpp_
+#define _SendQueue_hpp_
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/// @brief UDP 发送队列，累积待发送的数据报，用 sendmmsg 一次系统调用批量发出
+/// 目的地址在入队前解析为 sockaddr_in，队列内部存储循环复用，稳定后入队不再分配内存。非线程安全。
+class SendQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @param max_messages 积累到该条数时自动发送
+    /// @param max_delay 最早入队的数据报等待的最长时长，到期由使用者（见 UdpSocket::setFlushLoop）发送
+    SendQueue(size_t max_messages = 64, std::chrono::microseconds max_delay = std::chrono::milliseconds(1));
+
+    /// @brief 把点分十进制地址解析成 sockaddr_in，解析失败返回 false
+    static bool resolve(const std::string &ip, uint16_t port, sockaddr_in &addr);
+
+    void push(const void *data, size_t length, const sockaddr_in &dest_addr); ///< 拷贝数据入队
+    bool full() const { return count >= maxMessages; }                       ///< 是否达到条数阈值
+    bool due(Clock::time_point now = Clock::now()) const;                     ///< 是否达到时间阈值
+    size_t size() const { return count; }
+    std::chrono::microseconds delay() const { return maxDelay; } ///< 时间阈值
+    bool empty() const { return count == 0; }
+    void setThreshold(size_t max_messages, std::chrono::microseconds max_delay);
+
+    /// @brief 用 sendmmsg 发出排队的数据报。发送缓冲区满（EAGAIN/ENOBUFS）时未发出的数据报按原顺序留在队列中等下次发送；
+    /// 单条数据报出错（如广播地址未开 SO_BROADCAST 时的 EACCES）只丢弃该条，其余继续发送
+    /// @return 实际发出的条数，一条都没发出且出错时返回 -1 并保留 errno
+    int flush(int socket_fd);
+    size_t lastDropped() const { return droppedCount; } ///< 上一次 flush 因出错丢弃的条数
+    size_t lastBytes() const { return sentBytes; }      ///< 上一次 flush 发出的字节数
+
+private:
+    size_t maxMessages;
+    std::chrono::microseconds maxDelay;
+    size_t count = 0;                 ///< 当前排队条数
+    size_t usedBytes = 0;             ///< storage 已使用字节数，队列清空时才回绕
+    size_t droppedCount = 0;          ///< 上一次 flush 丢弃的条数
+    size_t sentBytes = 0;             ///< 上一次 flush 发出的字节数
+    Clock::time_point firstPushTime;  ///< 本轮最早入队时间
+    std::vector<uint8_t> storage;     ///< 所有排队数据报的连续存储
+    std::vector<size_t> offsets;      ///< 各数据报在 storage 中的偏移
+    std::vector<mmsghdr> headers;     ///< sendmmsg 消息头
+    std::vector<iovec> iovecs;        ///< 各数据报的缓冲区描述，发送前才填入地址
+    std::vector<sockaddr_in> dests;   ///< 各数据报的目的地址
+};
+#endif
@@ -7,6 +7,116 @@
  * @LastEditTime: 2024-10-25 10:53:11
  */
 #include "SockKit.hpp"
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <linux/filter.h>
+#include <set>
+
+namespace
+{
+    constexpr int maxReadsPerWakeup = 16; ///< 事件循环模式下每次唤醒单个 fd 最多读取的次数
+    constexpr uint32_t connectionEvents = EPOLLIN | EPOLLRDHUP; ///< 事件循环模式下服务端连接关注的事件
+
+    // 把逐包回调包装成批量回调
+    BatchRecvCallback toBatchCallback(RecvCallback recvCallback)
+    {
+        return [recvCallback](PacketBatch &batch)
+        {
+            for (size_t i = 0; i < batch.size(); i++)
+                recvCallback(batch.view(i));
+        };
+    }
+
+    // 非阻塞套接字上发送全部数据，缓冲区满时等待可写
+    int sendAll(int fd, const std::string &message)
+    {
+        size_t sent = 0;
+        while (sent < message.size())
+        {
+            auto sendBytes = ::send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+            if (sendBytes >= 0)
+            {
+                sent += sendBytes;
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return sent > 0 ? static_cast<int>(sent) : -1;
+            pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, -1);
+        }
+        return static_cast<int>(sent);
+    }
+
+    // 套接字本端（peer 为 true 时对端）的 "ip:端口"，用于指标名称
+    std::string endpointName(int fd, bool peer = false)
+    {
+        sockaddr_in addr = {};
+        socklen_t addrLen = sizeof(addr);
+        if ((peer ? getpeername(fd, (sockaddr *)&addr, &addrLen) : getsockname(fd, (sockaddr *)&addr, &addrLen)) < 0)
+            return "unknown";
+        char ipStr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ipStr, sizeof(ipStr));
+        return std::string(ipStr) + ":" + std::to_string(ntohs(addr.sin_port));
+    }
+
+    bool enableRecvTimestamps(int fd, bool enable)
+    {
+        int opt = enable ? 1 : 0;
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) < 0)
+        {
+            std::cerr << "设置 SO_TIMESTAMPNS 失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t sinceNs(PacketView::Clock::time_point since, PacketView::Clock::time_point now)
+    {
+        return now > since ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count() : 0;
+    }
+
+    // 记录一次成功的批量接收，并在计时范围内执行回调
+    void receiveBatch(const StageMetrics &metrics, LatencyHistogram *kernel_delay, PacketBatch &batch, const BatchRecvCallback &batchCallback)
+    {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < batch.size(); i++)
+            bytes += batch.length(i);
+        metrics.packets->add(batch.size());
+        metrics.bytes->add(bytes);
+        if (batch.kernelStamped() && kernel_delay)
+        {
+            for (size_t i = 0; i < batch.size(); i++)
+                kernel_delay->record(sinceNs(batch.recvTime(i), batch.recvTime()));
+        }
+        ScopedLatency latency(metrics.latency);
+        batchCallback(batch);
+    }
+
+    // 流套接字上的一次读取，带回接收时间：开启 SO_TIMESTAMPNS 时为内核时间戳并记录到 kernel_delay，否则为当前时间
+    int recvStamped(int fd, void *buffer, size_t length, PacketView::Clock::time_point &recv_time, LatencyHistogram *kernel_delay)
+    {
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timespec))];
+        iovec iov = {buffer, length};
+        msghdr header = {};
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        auto recvBytes = ::recvmsg(fd, &header, 0);
+        if (recvBytes <= 0)
+            return static_cast<int>(recvBytes);
+        auto now = PacketView::Clock::now();
+        recv_time = now;
+        if (kernelRecvTime(header, recv_time) && kernel_delay)
+            kernel_delay->record(sinceNs(recv_time, now));
+        return static_cast<int>(recvBytes);
+    }
+}
 
 UdpSocket::UdpSocket()
 {
@@ -122,23 +232,170 @@ bool UdpSocket::send(const std::string &message, const std::string &destIp, uint
     return sendRes <= 0 ? false : true;
 };
 
+bool UdpSocket::enqueue(const std::string &message, const sockaddr_in &destAddr)
+{
+    if (socketStrategy == nullptr)
+        return false;
+    else if (message.length() <= 0 || message.length() > 4096)
+        return false;
+    std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+    if (this->sendQueue.due())
+        this->flushQueue();
+    bool first = this->sendQueue.empty();
+    this->sendQueue.push(message.data(), message.length(), destAddr);
+    if (this->sendQueue.full())
+        this->flushQueue();
+    else if (first)
+        this->armFlushTimer();
+    return true;
+};
+
+void UdpSocket::armFlushTimer()
+{
+    if (this->flushTimerFd < 0)
+        return;
+    // 一次性定时，覆盖上一轮尚未触发的定时；到期时队列已空则什么都不做
+    auto delay = this->sendQueue.delay().count();
+    itimerspec spec = {};
+    spec.it_value.tv_sec = delay / 1000000;
+    spec.it_value.tv_nsec = delay % 1000000 * 1000;
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1; // 全零会解除定时
+    if (timerfd_settime(this->flushTimerFd, 0, &spec, nullptr) < 0)
+        std::cerr << "设置发送队列定时失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+};
+
+bool UdpSocket::enqueue(const std::string &message, const std::string &destIp, uint16_t destPort)
+{
+    sockaddr_in destAddr;
+    if (destPort <= 0 || !SendQueue::resolve(destIp, destPort, destAddr))
+        return false;
+    return this->enqueue(message, destAddr);
+};
+
+int UdpSocket::flush()
+{
+    std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+    return this->flushQueue();
+};
+
+int UdpSocket::flushQueue()
+{
+    if (socketStrategy == nullptr)
+        return -1;
+    auto sendCount = this->socketStrategy->sendBatch(this->socketFd, this->sendQueue);
+    if (!this->sendQueue.empty())
+        this->armFlushTimer(); // 发送缓冲区满时留下的数据报由定时器重试
+    return sendCount;
+};
+
+bool UdpSocket::flushIfDue()
+{
+    std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+    return this->sendQueue.due() ? this->flushQueue() > 0 : false;
+};
+
+void UdpSocket::setSendQueue(size_t maxMessages, std::chrono::microseconds maxDelay)
+{
+    std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+    this->sendQueue.setThreshold(maxMessages, maxDelay);
+};
+
+bool UdpSocket::setFlushLoop(EventLoop &eventLoop)
+{
+    if (this->flushTimerFd >= 0)
+        return this->flushLoop == &eventLoop;
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd < 0)
+    {
+        std::cerr << "创建发送队列定时器失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+    auto added = eventLoop.add(timerFd, EPOLLIN, [this, timerFd](uint32_t)
+                               {
+        uint64_t expirations = 0;
+        if (::read(timerFd, &expirations, sizeof(expirations)) < 0)
+            return; // 已被下一次入队重新定时
+        std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+        if (!this->sendQueue.empty())
+            this->flushQueue(); });
+    if (!added)
+    {
+        close(timerFd);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+    this->flushTimerFd = timerFd;
+    this->flushLoop = &eventLoop;
+    return true;
+};
+
+void UdpSocket::stopFlushTimer()
+{
+    if (this->flushTimerFd < 0)
+        return;
+    this->flushLoop->remove(this->flushTimerFd); // 等待正在执行的定时刷新返回
+    std::lock_guard<std::mutex> lock(this->sendQueueMutex);
+    close(this->flushTimerFd);
+    this->flushTimerFd = -1;
+    this->flushLoop = nullptr;
+};
+
+bool UdpSocket::setRecvTimestamps(bool enable)
+{
+    return enableRecvTimestamps(*this->socketFd, enable);
+};
+
 bool UdpSocket::recv(RecvCallback recvCallback)
 {
     return this->socketStrategy->recv(this->socketFd, recvCallback, 4096);
 };
 
+bool UdpSocket::recvBatch(BatchRecvCallback batchCallback, int batchSize)
+{
+    return this->socketStrategy->recvBatch(this->socketFd, batchCallback, batchSize, 4096, nullptr) == 0;
+};
+
+bool UdpSocket::recv(RecvCallback recvCallback, EventLoop &eventLoop)
+{
+    return this->recvBatch(toBatchCallback(recvCallback), eventLoop);
+};
+
+bool UdpSocket::recvBatch(BatchRecvCallback batchCallback, EventLoop &eventLoop, int batchSize)
+{
+    if (this->eventLoop)
+        return false; // 已注册到事件循环
+    if (this->socketStrategy->recvBatch(this->socketFd, batchCallback, batchSize, 4096, &eventLoop) != 0)
+        return false;
+    this->eventLoop = &eventLoop;
+    if (this->flushTimerFd < 0)
+        this->setFlushLoop(eventLoop); // 失败时退回到入队时检查时间阈值
+    return true;
+};
+
 bool UdpSocket::recvSwitch(bool rSwitch)
 {
+    if (!rSwitch && this->eventLoop)
+    {
+        this->eventLoop->remove(*this->socketFd); // 等待正在执行的回调返回
+        this->eventLoop = nullptr;
+    }
     return this->socketStrategy->recvSwitch(rSwitch);
 };
 
 bool UdpSocket::sockClose()
 {
-    close(*this->socketFd);
+    this->recvSwitch(false);
+    this->stopFlushTimer();
+    return close(*this->socketFd) == 0;
 };
 
 UdpSocket::~UdpSocket()
 {
+    this->stopFlushTimer();
+    this->flush(); // 发出尚在队列中的数据报
+    if (this->eventLoop)
+        this->eventLoop->remove(*this->socketFd);
     close(*this->socketFd);
 };
 
@@ -149,18 +406,68 @@ int UDPUnicastStrategy::send(std::shared_ptr<int> socketFd, const std::string &m
     clientAddr.sin_port = htons(destPort);
     clientAddr.sin_addr.s_addr = inet_addr(destIp.c_str());
     auto sendByte = sendto(*socketFd, message.c_str(), message.length(), 0, (const struct sockaddr *)&clientAddr, sizeof(clientAddr));
-    std::cout << sendByte << std::endl;
     return sendByte;
 };
 
+int UDPUnicastStrategy::sendBatch(std::shared_ptr<int> socketFd, SendQueue &sendQueue)
+{
+    if (!this->sendMetrics)
+        this->sendMetrics = MetricsRegistry::getInstance().stage("udp." + endpointName(*socketFd) + ".send");
+    auto sendCount = sendQueue.flush(*socketFd);
+    auto sendErrno = errno;
+    if (sendCount > 0)
+    {
+        this->sendMetrics.packets->add(sendCount);
+        this->sendMetrics.bytes->add(sendQueue.lastBytes());
+    }
+    if (sendQueue.lastDropped())
+    {
+        this->sendMetrics.dropped->add(sendQueue.lastDropped());
+        this->sendMetrics.errors->add();
+    }
+    if (sendCount < 0 && sendErrno != EAGAIN && sendErrno != EWOULDBLOCK && sendErrno != ENOBUFS)
+        std::cerr << "批量发送失败, errno: " << sendErrno << " - " << strerror(sendErrno) << std::endl;
+    errno = sendErrno;
+    return sendCount;
+};
+
 int UDPUnicastStrategy::recv(std::shared_ptr<int> socketFd, RecvCallback recvCallback, int bufferSize)
+{
+    // 兼容逐包回调：底层仍按批接收，逐个数据报转换成视图后回调
+    return this->recvBatch(socketFd, toBatchCallback(recvCallback), defaultRecvBatchSize, bufferSize, nullptr);
+};
+
+int UDPUnicastStrategy::recvBatch(std::shared_ptr<int> socketFd, BatchRecvCallback batchCallback, int batchSize, int bufferSize, EventLoop *eventLoop)
 {
     this->recvFlag = true;
-    socklen_t len = sizeof(sockaddr_in);
-    sockaddr_in clientAddr;
-    this->buffer.resize(bufferSize);
-    std::cout << "准备进行 recvfrom 操作，socketFd: " << *socketFd << std::endl;
-    recvThread = std::make_unique<std::thread>([socketFd, this, recvCallback, &bufferSize]()
+    this->batch = std::make_unique<PacketBatch>(batchSize, bufferSize);
+    auto metricsName = "udp." + endpointName(*socketFd) + ".recv";
+    this->recvMetrics = MetricsRegistry::getInstance().stage(metricsName);
+    this->kernelDelay = &MetricsRegistry::getInstance().histogram(metricsName + ".kernel_to_user_ns");
+    if (eventLoop)
+    {
+        auto added = eventLoop->add(*socketFd, EPOLLIN, [socketFd, this, batchCallback](uint32_t)
+                                    {
+            // 每次唤醒最多收取若干批，未取完的数据由水平触发在下一轮继续处理
+            for (int i = 0; i < maxReadsPerWakeup && this->recvFlag; i++)
+            {
+                if (this->batch->receive(*socketFd) < 0)
+                {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    {
+                        this->recvMetrics.errors->add();
+                        std::cerr << "接收错误, errno: " << errno << " - " << strerror(errno) << std::endl;
+                    }
+                    break;
+                }
+                receiveBatch(this->recvMetrics, this->kernelDelay, *this->batch, batchCallback);
+                if (this->batch->size() < this->batch->capacity())
+                    break; // 已取空
+            } });
+        return added ? 0 : -1;
+    }
+    std::cout << "准备进行 recvmmsg 操作，socketFd: " << *socketFd << std::endl;
+    recvThread = std::make_unique<std::thread>([socketFd, this, batchCallback]()
                                                {
         while (this->recvFlag)
         {   
@@ -169,17 +476,12 @@ int UDPUnicastStrategy::recv(std::shared_ptr<int> socketFd, RecvCallback recvCal
                 std::cerr << "socketFd 无效: " << *socketFd << std::endl;
                 return; 
             }
-            sockaddr_in clientAddr; // 转为string ip int port
-            socklen_t len = sizeof(clientAddr);
-            ssize_t recv_len = recvfrom(*socketFd, (void *)this->buffer.data(), bufferSize, 0, (struct sockaddr *)&clientAddr, &len);
-            if (recv_len < 0) {
+            if (this->batch->receive(*socketFd) < 0) {
+                this->recvMetrics.errors->add();
                 std::cerr << "接收错误, errno: " << errno << " - " << strerror(errno) << std::endl;
                 continue;
             }
-            char ipStr[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &(clientAddr.sin_addr), ipStr, sizeof(ipStr));
-            int port = ntohs(clientAddr.sin_port);
-            recvCallback(this->buffer, recv_len, {ipStr,port});
+            receiveBatch(this->recvMetrics, this->kernelDelay, *this->batch, batchCallback); // 直接在接收槽位上处理，不拷贝
         } });
 
     recvThread->detach();
@@ -192,43 +494,404 @@ bool UDPUnicastStrategy::recvSwitch(bool rSwitch)
     {
         this->recvThread->join(); // 等待线程退出
     }
+    return true;
 };
 
+ShardedUdpSocket::ShardedUdpSocket(const std::string &ip, int port, const ShardOptions &shard_options) : options(shard_options)
+{
+    if (this->options.shardCount == 0)
+        this->options.shardCount = std::max(1u, std::thread::hardware_concurrency());
+    this->boundPort = port < 0 || port > 65535 ? 0 : port;
+    for (size_t i = 0; i < this->options.shardCount; i++)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            std::cerr << "创建套接字失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+            break;
+        }
+        int opt = 1;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(this->boundPort);
+        addr.sin_addr.s_addr = ip.empty() ? INADDR_ANY : inet_addr(ip.c_str());
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0 || ::bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            std::cerr << "分片套接字绑定失败，errno: " << errno << " - " << strerror(errno) << std::endl;
+            close(fd);
+            break;
+        }
+        if (this->boundPort == 0)
+        {
+            socklen_t addrLen = sizeof(addr);
+            getsockname(fd, (sockaddr *)&addr, &addrLen);
+            this->boundPort = ntohs(addr.sin_port);
+        }
+        if (this->options.recvTimestamps)
+            enableRecvTimestamps(fd, true);
+        auto t_shard = std::make_unique<Shard>();
+        t_shard->fd = fd;
+        this->shards.push_back(std::move(t_shard));
+    }
+    if (this->shards.size() != this->options.shardCount)
+    {
+        // 部分分片失败时不留下不完整的分组，否则内核仍会把数据报散列到已打开的套接字上
+        for (auto &t_shard : this->shards)
+            close(t_shard->fd);
+        this->shards.clear();
+        return;
+    }
+    if (this->options.cpuSteering && this->shards.size() > 1)
+        this->attachCpuSteering();
+}
+
+bool ShardedUdpSocket::attachCpuSteering()
+{
+    // 经典 BPF：A = 收包 CPU；A %= 分片数；返回值即分组内按绑定顺序的套接字下标
+    sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(this->shards.size())},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    sock_fprog program = {static_cast<unsigned short>(std::size(code)), code};
+    if (setsockopt(this->shards.front()->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) < 0)
+    {
+        std::cerr << "附加 SO_ATTACH_REUSEPORT_CBPF 失败，按四元组散列分片，errno: " << errno << " - " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ShardedUdpSocket::recv(RecvCallback recvCallback)
+{
+    return this->recvBatch(toBatchCallback(recvCallback));
+}
+
+bool ShardedUdpSocket::recvBatch(BatchRecvCallback batchCallback)
+{
+    if (this->shards.empty() || this->running.exchange(true))
+        return false;
+    auto metricsName = "udp." + endpointName(this->shards.front()->fd) + ".recv";
+    std::set<size_t> allowedCpus;
+    cpu_set_t processCpus;
+    if (sched_getaffinity(0, sizeof(processCpus), &processCpus) == 0)
+    {
+        for (size_t i = 0; i < this->shards.size() && i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET(i, &processCpus))
+                allowedCpus.insert(i);
+        }
+    }
+    for (size_t i = 0; i < this->shards.size(); i++)
+    {
+        auto &t_shard = *this->shards[i];
+        auto t_name = metricsName + ".shard" + std::to_string(i);
+        t_shard.recvMetrics = MetricsRegistry::getInstance().stage(t_name);
+        t_shard.kernelDelay = &MetricsRegistry::getInstance().histogram(t_name + ".kernel_to_user_ns");
+        t_shard.batch = std::make_unique<PacketBatch>(this->options.batchSize, 4096);
+        int t_cpu = -1;
+        if (!this->options.cpus.empty())
+            t_cpu = this->options.cpus[i % this->options.cpus.size()];
+        else if (this->options.cpuSteering && allowedCpus.count(i))
+            t_cpu = static_cast<int>(i); // 只绑定本进程可用的 CPU，超出的分片收不到数据报
+        t_shard.thread = std::thread(&ShardedUdpSocket::receiveLoop, this, std::ref(t_shard), t_cpu, batchCallback);
+    }
+    return true;
+}
+
+void ShardedUdpSocket::receiveLoop(Shard &shard, int cpu, const BatchRecvCallback &batchCallback)
+{
+    if (cpu >= 0)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if (res != 0)
+            std::cerr << "接收线程绑定 CPU " << cpu << " 失败，errno: " << res << " - " << strerror(res) << std::endl;
+    }
+    while (this->running)
+    {
+        if (shard.batch->receive(shard.fd) < 0)
+        {
+            if (!this->running || errno == EINTR)
+                continue;
+            shard.recvMetrics.errors->add();
+            std::cerr << "接收错误, errno: " << errno << " - " << strerror(errno) << std::endl;
+            continue;
+        }
+        if (!this->running)
+            break; // stop() 的 shutdown 唤醒，收到的是空数据报
+        receiveBatch(shard.recvMetrics, shard.kernelDelay, *shard.batch, batchCallback);
+    }
+}
+
+void ShardedUdpSocket::stop()
+{
+    this->running = false;
+    // 未连接的 UDP 套接字上 shutdown 返回 ENOTCONN，但仍会唤醒阻塞在 recvmmsg 中的线程；之后套接字不能再接收
+    for (auto &t_shard : this->shards)
+        ::shutdown(t_shard->fd, SHUT_RD);
+    for (auto &t_shard : this->shards)
+    {
+        if (t_shard->thread.joinable())
+            t_shard->thread.join();
+        close(t_shard->fd);
+    }
+    this->shards.clear();
+}
+
+ShardedUdpSocket::~ShardedUdpSocket()
+{
+    this->stop();
+}
+
 bool TCPServerStrategy::connect(TcpSocketInfo &socketInfo)
 {
     std::cerr << "Server does not need to connect." << std::endl;
     return false;
 }
 
-int TCPServerStrategy::send(TcpSocketInfo &socketInfo, const std::string &message)
+namespace
 {
-    return socketInfo.socketAcceptFd > 0 ? ::send(socketInfo.socketAcceptFd, message.c_str(), message.size(), 0) : false;
-}
+    using Connection = TCPServerStrategy::Connection;
+    using ServerState = TCPServerStrategy::ServerState;
 
-int TCPServerStrategy::recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize)
-{
-    this->buffer.resize(bufferSize);
-    this->recvFlag = true;
-    this->recvThread = std::make_unique<std::thread>([this, &socketInfo, recvCallback, bufferSize]()
-                                                     {
+    std::shared_ptr<Connection> findConnection(ServerState &state, uint64_t connId)
+    {
+        std::lock_guard<std::mutex> lock(state.connMutex);
+        auto it = state.connTable.find(connId);
+        return it == state.connTable.end() ? nullptr : it->second;
+    }
+
+    int sendOnConnection(Connection &conn, const std::string &message)
+    {
+        std::lock_guard<std::mutex> lock(conn.sendMutex);
+        if (conn.fd < 0)
+            return -1; // 已关闭，fd 号可能已被复用
+        auto sendBytes = sendAll(conn.fd, message);
+        if (sendBytes > 0)
+            conn.bytesSent += sendBytes;
+        return sendBytes;
+    }
+
+    // 关闭连接的 fd 并置为 -1。与发送共用 sendMutex，发送方拿到连接后不会写到已关闭（可能被复用）的 fd 上
+    void closeConnectionFd(Connection &conn)
+    {
+        std::lock_guard<std::mutex> lock(conn.sendMutex);
+        if (conn.fd >= 0)
+            ::close(conn.fd);
+        conn.fd = -1;
+    }
+
+    // 从连接表中摘除连接。事件循环模式下由此处关闭 fd；线程模式下只 shutdown 唤醒接收线程，由接收线程关闭 fd
+    bool dropConnection(ServerState &state, uint64_t connId)
+    {
+        std::shared_ptr<Connection> conn;
+        {
+            std::lock_guard<std::mutex> lock(state.connMutex);
+            auto it = state.connTable.find(connId);
+            if (it == state.connTable.end())
+                return false;
+            conn = it->second;
+            state.connTable.erase(it);
+        }
+        if (state.eventLoop)
+        {
+            state.eventLoop->remove(conn->fd); // 等待该连接正在执行的回调返回
+            closeConnectionFd(*conn);
+            if (state.closeCallback)
+                state.closeCallback(connId);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(conn->sendMutex);
+            if (conn->fd >= 0)
+                ::shutdown(conn->fd, SHUT_RDWR);
+        }
+        return true;
+    }
+
+    enum ReadResult
+    {
+        rr_data,      ///< 读到数据并已回调
+        rr_wouldBlock, ///< 暂无数据
+        rr_closed     ///< 对端关闭或出错
+    };
+
+    // 读取一次连接上的数据
+    ReadResult readConnection(ServerState &state, Connection &conn)
+    {
+        auto *buffer = conn.buffer.prepare();
+        if (!buffer)
+        {
+            state.recvMetrics.errors->add(); // 缓冲池达到上限
+            return rr_closed;
+        }
+        PacketView::Clock::time_point recvTime;
+        int bytesReceived = recvStamped(conn.fd, buffer, state.bufferSize, recvTime, state.kernelDelay);
+        if (bytesReceived > 0)
+        {
+            conn.bytesReceived += bytesReceived;
+            conn.recvCount++;
+            state.recvMetrics.packets->add();
+            state.recvMetrics.bytes->add(bytesReceived);
+            ScopedLatency latency(state.recvMetrics.latency);
+            PacketView packet(buffer, bytesReceived, conn.peer, recvTime, conn.connId);
+            packet.slab = conn.buffer.current();
+            state.recvCallback(packet);
+            return rr_data;
+        }
+        if (bytesReceived < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return rr_wouldBlock;
+        if (bytesReceived < 0)
+            state.recvMetrics.errors->add(); // 对端正常关闭不计为错误
+        return rr_closed;
+    }
+
+    // 接受一个新连接并登记到连接表，按模式交给事件循环或独立线程接收
+    bool acceptConnection(const std::shared_ptr<ServerState> &state, int listenFd)
+    {
         sockaddr_in clientAddr;
         socklen_t clientLen = sizeof(clientAddr);
-        socketInfo.socketAcceptFd = accept(socketInfo.socketFd, (sockaddr *)&clientAddr, &clientLen);
-        if (socketInfo.socketAcceptFd < 0)
+        int acceptFd = accept4(listenFd, (sockaddr *)&clientAddr, &clientLen, SOCK_CLOEXEC);
+        if (acceptFd < 0)
+            return false;
+
+        auto conn = std::make_shared<Connection>();
+        char ipStr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(clientAddr.sin_addr), ipStr, sizeof(ipStr));
+        conn->connId = state->nextConnId++;
+        conn->fd = acceptFd;
+        conn->peer = {ipStr, ntohs(clientAddr.sin_port)};
+        conn->buffer = ReceiveSlot(BufferPool::forSize(state->bufferSize));
+        conn->connectedTime = PacketView::Clock::now();
         {
-            std::cerr << "Accept 失败!" << std::endl;
-            return;
+            std::lock_guard<std::mutex> lock(state->connMutex);
+            state->connTable[conn->connId] = conn;
         }
-        while (recvFlag)
+        state->lastConnId = conn->connId;
+
+        if (state->eventLoop)
         {
-            int bytesReceived = ::recv(socketInfo.socketAcceptFd , &this->buffer[0], bufferSize, 0);
-            if (bytesReceived > 0)
+            auto added = state->eventLoop->add(acceptFd, state->recvFlag ? connectionEvents : 0, [state, conn](uint32_t events)
+                                               {
+                if (!state->recvFlag)
+                {
+                    // 接收已暂停，fd 不再关注可读；仍会上报的挂断与错误直接关闭连接
+                    if (events & (EPOLLHUP | EPOLLERR))
+                        dropConnection(*state, conn->connId);
+                    return;
+                }
+                for (int i = 0; i < maxReadsPerWakeup; i++)
+                {
+                    auto res = readConnection(*state, *conn);
+                    if (res == rr_closed)
+                        dropConnection(*state, conn->connId); // 对端关闭或出错
+                    if (res != rr_data)
+                        return;
+                } });
+            if (!added)
+                dropConnection(*state, conn->connId);
+            return added;
+        }
+
+        std::thread([state, conn]()
+                    {
+            while (state->recvFlag && readConnection(*state, *conn) != rr_closed)
             {
-                recvCallback(this->buffer, bytesReceived, {"", 0});
             }
-            else if (bytesReceived == 0 || (bytesReceived < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
             {
-                break;
+                std::lock_guard<std::mutex> lock(state->connMutex);
+                state->connTable.erase(conn->connId);
+            }
+            closeConnectionFd(*conn);
+            if (state->closeCallback)
+                state->closeCallback(conn->connId); })
+            .detach();
+        return true;
+    }
+}
+
+int TCPServerStrategy::send(TcpSocketInfo &socketInfo, const std::string &message)
+{
+    return this->sendTo(this->state->lastConnId, message);
+}
+
+int TCPServerStrategy::sendTo(uint64_t connId, const std::string &message)
+{
+    auto conn = findConnection(*this->state, connId);
+    return conn ? sendOnConnection(*conn, message) : -1;
+}
+
+int TCPServerStrategy::broadcast(const std::string &message)
+{
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(this->state->connMutex);
+        targets.reserve(this->state->connTable.size());
+        for (auto &t_item : this->state->connTable)
+            targets.push_back(t_item.second);
+    }
+    int sentCount = 0;
+    for (auto &t_conn : targets)
+        sentCount += sendOnConnection(*t_conn, message) > 0 ? 1 : 0;
+    return sentCount;
+}
+
+bool TCPServerStrategy::closeConnection(uint64_t connId)
+{
+    return dropConnection(*this->state, connId);
+}
+
+void TCPServerStrategy::setCloseCallback(StreamCloseCallback closeCallback)
+{
+    this->state->closeCallback = std::move(closeCallback);
+}
+
+std::vector<TcpConnectionStat> TCPServerStrategy::connections()
+{
+    std::vector<TcpConnectionStat> stats;
+    std::lock_guard<std::mutex> lock(this->state->connMutex);
+    stats.reserve(this->state->connTable.size());
+    for (auto &[t_connId, t_conn] : this->state->connTable)
+        stats.push_back({t_connId, t_conn->peer, t_conn->bytesReceived, t_conn->bytesSent, t_conn->recvCount, t_conn->connectedTime});
+    return stats;
+}
+
+int TCPServerStrategy::recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize, EventLoop *eventLoop)
+{
+    auto state = this->state;
+    state->recvCallback = recvCallback;
+    state->bufferSize = bufferSize;
+    state->eventLoop = eventLoop;
+    state->listenFd = socketInfo.socketFd;
+    state->recvFlag = true;
+    int listenFd = socketInfo.socketFd;
+    auto metricsName = "tcp." + endpointName(listenFd) + ".recv";
+    state->recvMetrics = MetricsRegistry::getInstance().stage(metricsName);
+    state->kernelDelay = &MetricsRegistry::getInstance().histogram(metricsName + ".kernel_to_user_ns");
+    if (eventLoop)
+    {
+        // 监听 fd 常驻事件循环，每次可读时接受所有排队的连接
+        auto added = eventLoop->add(listenFd, EPOLLIN, [state, listenFd](uint32_t)
+                                    {
+            while (acceptConnection(state, listenFd))
+            {
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                std::cerr << "Accept 失败, errno: " << errno << " - " << strerror(errno) << std::endl; });
+        return added ? 0 : -1;
+    }
+    this->recvThread = std::make_unique<std::thread>([state, listenFd]()
+                                                     {
+        while (state->recvFlag)
+        {
+            if (!acceptConnection(state, listenFd) && errno != EINTR)
+            {
+                if (state->recvFlag)
+                    std::cerr << "Accept 失败, errno: " << errno << " - " << strerror(errno) << std::endl;
+                return;
             }
         } });
     this->recvThread->detach();
@@ -237,8 +900,11 @@ int TCPServerStrategy::recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback
 
 bool TCPServerStrategy::close(TcpSocketInfo &socketInfo)
 {
-    this->recvFlag = false;
-    return ::shutdown(socketInfo.socketFd, SHUT_RDWR) == 0;
+    this->state->recvFlag = false;
+    auto res = ::shutdown(socketInfo.socketFd, SHUT_RDWR) == 0;
+    for (auto &t_stat : this->connections())
+        dropConnection(*this->state, t_stat.connId);
+    return res;
 }
 
 bool TCPServerStrategy::bind(TcpSocketInfo &socketInfo)
@@ -274,15 +940,23 @@ bool TCPServerStrategy::bind(TcpSocketInfo &socketInfo)
 
 bool TCPServerStrategy::recvSwitch(bool rSwitch)
 {
-    return this->recvFlag = rSwitch;
+    auto &state = *this->state;
+    state.recvFlag = rSwitch;
+    if (!state.eventLoop)
+        return true;
+    // 事件循环模式下监听 fd 与各连接 fd 保留在循环中，只停止/恢复关注可读，暂停期间数据留在内核缓冲区
+    state.eventLoop->modify(state.listenFd, rSwitch ? uint32_t(EPOLLIN) : 0u);
+    std::lock_guard<std::mutex> lock(state.connMutex);
+    for (auto &t_item : state.connTable)
+        state.eventLoop->modify(t_item.second->fd, rSwitch ? connectionEvents : 0u);
+    return true;
 }
 
 TCPServerStrategy::~TCPServerStrategy()
 {
-    if (this->recvThread && this->recvThread->joinable())
-    {
-        this->recvThread->join();
-    }
+    this->state->recvFlag = false;
+    for (auto &t_stat : this->connections())
+        dropConnection(*this->state, t_stat.connId);
 }
 TcpSocket::TcpSocket(TcpModel tcpModel, const std::string &ip, int port) : socketInfo(-1)
 {
@@ -313,23 +987,78 @@ int TcpSocket::send(const std::string &message)
     return strategy ? strategy->send(socketInfo, message) : -1;
 }
 
+int TcpSocket::sendTo(uint64_t connId, const std::string &message)
+{
+    return strategy ? strategy->sendTo(connId, message) : -1;
+}
+
+int TcpSocket::broadcast(const std::string &message)
+{
+    return strategy ? strategy->broadcast(message) : -1;
+}
+
+bool TcpSocket::closeConnection(uint64_t connId)
+{
+    return strategy ? strategy->closeConnection(connId) : false;
+}
+
+std::vector<TcpConnectionStat> TcpSocket::connections()
+{
+    return strategy ? strategy->connections() : std::vector<TcpConnectionStat>{};
+}
+
+void TcpSocket::setCloseCallback(StreamCloseCallback closeCallback)
+{
+    if (strategy)
+        strategy->setCloseCallback(std::move(closeCallback));
+}
+
 int TcpSocket::recv(RecvCallback recvCallback)
 {
-    return strategy ? strategy->recv(this->socketInfo, recvCallback, 4096) : false;
+    return strategy ? strategy->recv(this->socketInfo, recvCallback, 4096, nullptr) : false;
+}
+
+int TcpSocket::recv(RecvCallback recvCallback, EventLoop &eventLoop)
+{
+    if (!strategy || this->eventLoop)
+        return -1;
+    auto res = strategy->recv(this->socketInfo, recvCallback, 4096, &eventLoop);
+    if (res == 0)
+        this->eventLoop = &eventLoop;
+    return res;
+}
+
+void TcpSocket::detachLoop()
+{
+    if (!this->eventLoop)
+        return;
+    // 只移除监听/客户端 fd，服务端各连接由 strategy 在 close 或析构时移除
+    this->eventLoop->remove(socketInfo.socketFd);
+    this->eventLoop = nullptr;
+}
+
+bool TcpSocket::setRecvTimestamps(bool enable)
+{
+    return enableRecvTimestamps(socketInfo.socketFd, enable);
 }
 
 bool TcpSocket::close()
 {
+    this->detachLoop();
     return strategy ? strategy->close(socketInfo) : false;
 }
 
 bool TcpSocket::recvSwitch(bool rSwitch)
 {
-    return strategy ? strategy->recvSwitch(rSwitch) : false;
+    auto res = strategy ? strategy->recvSwitch(rSwitch) : false;
+    if (!rSwitch && !res)
+        this->detachLoop(); // 策略不支持暂停（客户端）时直接移出事件循环
+    return res;
 }
 
 TcpSocket::~TcpSocket()
 {
+    this->detachLoop();
     ::close(socketInfo.socketFd);
 }
 
@@ -359,22 +1088,62 @@ bool TCPClientStrategy::connect(TcpSocketInfo &socketInfo)
 
 int TCPClientStrategy::send(TcpSocketInfo &socketInfo, const std::string &message)
 {
-    return ::send(socketInfo.socketFd, message.c_str(), message.size(), 0);
+    return sendAll(socketInfo.socketFd, message);
 }
 
-int TCPClientStrategy::recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize)
+int TCPClientStrategy::recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize, EventLoop *eventLoop)
 {
-    this->buffer.resize(bufferSize);
-    this->recvThread = std::make_unique<std::thread>([this, &socketInfo, recvCallback, &bufferSize]()
+    this->buffer = ReceiveSlot(BufferPool::forSize(bufferSize));
+    auto metricsName = "tcp.client." + endpointName(socketInfo.socketFd, true) + ".recv";
+    this->recvMetrics = MetricsRegistry::getInstance().stage(metricsName);
+    this->kernelDelay = &MetricsRegistry::getInstance().histogram(metricsName + ".kernel_to_user_ns");
+    if (eventLoop)
+    {
+        auto added = eventLoop->add(socketInfo.socketFd, EPOLLIN | EPOLLRDHUP, [this, &socketInfo, recvCallback, bufferSize, eventLoop](uint32_t)
+                                    {
+            for (int i = 0; i < maxReadsPerWakeup; i++)
+            {
+                PacketView::Clock::time_point recvTime;
+                auto *buffer = this->buffer.prepare();
+                int recvBytes = buffer ? recvStamped(socketInfo.socketFd, buffer, bufferSize, recvTime, this->kernelDelay) : -1;
+                if (recvBytes > 0)
+                {
+                    this->recvMetrics.packets->add();
+                    this->recvMetrics.bytes->add(recvBytes);
+                    ScopedLatency latency(this->recvMetrics.latency);
+                    PacketView packet(buffer, recvBytes, {socketInfo.connectedIp, socketInfo.connectedPort}, recvTime);
+                    packet.slab = this->buffer.current();
+                    recvCallback(packet);
+                    continue;
+                }
+                if (recvBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                    break;
+                if (recvBytes < 0)
+                    this->recvMetrics.errors->add();
+                eventLoop->remove(socketInfo.socketFd); // 服务端关闭或出错
+                if (this->closeCallback)
+                    this->closeCallback(0);
+                break;
+            } });
+        return added ? 0 : -1;
+    }
+    this->recvThread = std::make_unique<std::thread>([this, &socketInfo, recvCallback, bufferSize]()
                                                      {
-        auto recvBytes = -1;                      
-        recvBytes = ::recv(socketInfo.socketFd,&this->buffer[0], bufferSize, 0);
+        PacketView::Clock::time_point recvTime;
+        auto *buffer = this->buffer.prepare();
+        auto recvBytes = buffer ? recvStamped(socketInfo.socketFd, buffer, bufferSize, recvTime, this->kernelDelay) : -1;
         if (recvBytes < 0)
         {
+            this->recvMetrics.errors->add();
             std::cerr << "接收失败" << std::endl;
+            return;
         }
-        recvCallback(buffer,recvBytes,{socketInfo.connectedIp,socketInfo.connectedPort} );
-        this->buffer.clear(); });
+        this->recvMetrics.packets->add();
+        this->recvMetrics.bytes->add(recvBytes);
+        ScopedLatency latency(this->recvMetrics.latency);
+        PacketView packet(buffer, recvBytes, {socketInfo.connectedIp, socketInfo.connectedPort}, recvTime);
+        packet.slab = this->buffer.current();
+        recvCallback(packet); });
     this->recvThread->detach();
     return 0;
 }
@@ -383,6 +1152,8 @@ bool TCPClientStrategy::close(TcpSocketInfo &socketInfo)
 {
     ::shutdown(socketInfo.socketFd, SHUT_RDWR);
     ::close(socketInfo.socketFd);
+    if (this->closeCallback)
+        this->closeCallback(0);
     return true;
 }
 
@@ -397,9 +1168,34 @@ bool TCPClientStrategy::recvSwitch(bool rSwitch)
     return false;
 }
 
+int TCPClientStrategy::sendTo(uint64_t connId, const std::string &message)
+{
+    return -1; // 客户端只有一条连接，使用 send
+}
+
+int TCPClientStrategy::broadcast(const std::string &message)
+{
+    return -1;
+}
+
+bool TCPClientStrategy::closeConnection(uint64_t connId)
+{
+    return false;
+}
+
+std::vector<TcpConnectionStat> TCPClientStrategy::connections()
+{
+    return {};
+}
+
+void TCPClientStrategy::setCloseCallback(StreamCloseCallback closeCallback)
+{
+    this->closeCallback = std::move(closeCallback);
+}
+
 TCPClientStrategy::~TCPClientStrategy()
 {
-    if (this->recvThread->joinable())
+    if (this->recvThread && this->recvThread->joinable())
     {
         this->recvThread->join();
     }
@@ -6,6 +6,8 @@
  * @LastEditors: YangHouQi
  * @LastEditTime: 2024-10-24 17:31:31
  */
+#ifndef _SockKit_hpp_
+#define _SockKit_hpp_
 #include <iostream>
 #include <string>
 #include <memory>
@@ -18,6 +20,13 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <map>
+#include <vector>
+#include "PacketView.hpp"
+#include "PacketBatch.hpp"
+#include "SendQueue.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
 enum UdpModel
 {
     um_unicast,
@@ -29,22 +38,31 @@ enum TcpModel
     tm_server,
     tm_client
 };
-struct AddrInfo
-{
-    std::string ip = 0;
-    int port = 0;
-};
 struct TcpSocketInfo
 {
     int socketFd;
-    int socketAcceptFd;
     std::string connectedIp;
     uint16_t connectedPort;
     bool isConnected;
 
     TcpSocketInfo(int fd) : socketFd(fd), isConnected(false) {}
 };
-using RecvCallback = std::function<void(const std::string &buffer, int length, const AddrInfo &addrInfo)>;
+/// @brief TCP 服务端连接的统计快照
+struct TcpConnectionStat
+{
+    uint64_t connId = 0;        ///< 连接ID，服务端内唯一且不复用
+    AddrInfo peer;              ///< 对端地址
+    uint64_t bytesReceived = 0; ///< 已接收字节数
+    uint64_t bytesSent = 0;     ///< 已发送字节数
+    uint64_t recvCount = 0;     ///< 接收次数
+    PacketView::Clock::time_point connectedTime; ///< 建立连接的时间
+};
+/// 接收回调，packet 指向策略内部的接收缓冲区，回调返回后即失效；需要异步处理时构造 PacketRef 持有缓冲区，不必拷贝
+using RecvCallback = std::function<void(const PacketView &packet)>;
+/// 批量接收回调，batch 中的数据在下一次接收前有效
+using BatchRecvCallback = std::function<void(PacketBatch &batch)>;
+/// 流关闭回调，参数为该连接数据包的 PacketView::streamId，在该连接最后一次接收回调返回之后调用
+using StreamCloseCallback = std::function<void(uint64_t streamId)>;
 
 class SocketBase
 {
@@ -60,6 +78,9 @@ class SocketStrategyBase
 public:
     virtual int send(std::shared_ptr<int> socketFd, const std::string &message, const std::string &destIp, const uint16_t &destPort) = 0;
     virtual int recv(std::shared_ptr<int> socketFd, RecvCallback recvCallback, int bufferSize) = 0;
+    virtual int sendBatch(std::shared_ptr<int> socketFd, SendQueue &sendQueue) = 0;
+    /// eventLoop 为空时启动独立接收线程，否则注册到事件循环上由其线程接收
+    virtual int recvBatch(std::shared_ptr<int> socketFd, BatchRecvCallback batchCallback, int batchSize, int bufferSize, EventLoop *eventLoop) = 0;
     virtual bool recvSwitch(bool rSwitch) = 0;
     virtual ~SocketStrategyBase() = default;
 };
@@ -68,11 +89,16 @@ class UDPUnicastStrategy : public SocketStrategyBase
 public:
     int send(std::shared_ptr<int> socketFd, const std::string &message, const std::string &destIp, const uint16_t &destPort) override;
     int recv(std::shared_ptr<int> socketFd, RecvCallback recvCallback, int bufferSize) override;
+    int sendBatch(std::shared_ptr<int> socketFd, SendQueue &sendQueue) override;
+    int recvBatch(std::shared_ptr<int> socketFd, BatchRecvCallback batchCallback, int batchSize, int bufferSize, EventLoop *eventLoop) override;
     bool recvSwitch(bool rSwitch) override;
 
-    std::string buffer;
+    std::unique_ptr<PacketBatch> batch; ///< recvmmsg 接收槽位，启动接收时预分配
     std::unique_ptr<std::thread> recvThread;
     std::atomic<bool> recvFlag;
+    StageMetrics recvMetrics; ///< udp.<本端地址>.recv，启动接收时注册；latency 为批量回调的处理耗时
+    StageMetrics sendMetrics; ///< udp.<本端地址>.send，首次批量发送时注册；dropped 为因出错丢弃的数据报
+    LatencyHistogram *kernelDelay = nullptr; ///< 内核时间戳到用户态收取的间隔，只在开启 SO_TIMESTAMPNS 时记录
 };
 class UDPMulticastStrategy : public UDPUnicastStrategy
 {
@@ -88,7 +114,22 @@ public:
     UdpSocket(const std::string &ip, int port);
     UdpSocket(UdpModel udpModel, const std::string &ip, int port);
     bool send(const std::string &message, const std::string &destIp, uint16_t destPort) override;
+    bool enqueue(const std::string &message, const sockaddr_in &destAddr);                   ///< 入队待批量发送，达到阈值时自动发送
+    bool enqueue(const std::string &message, const std::string &destIp, uint16_t destPort); ///< 同上，每次调用都会解析地址
+    int flush();                                                                             ///< 立即发送队列中所有数据报
+    bool flushIfDue();                                                                       ///< 达到时间阈值时发送，未设置刷新事件循环时供调用方周期调用
+    void setSendQueue(size_t maxMessages, std::chrono::microseconds maxDelay);               ///< 设置发送队列阈值
+    /// @brief 在事件循环上注册一个 timerfd：队列由空变为非空时按时间阈值定时，到期由循环线程发出排队的数据报，
+    /// 突发流量的尾部不必等下一次入队。由事件循环接收（recv/recvBatch 的 EventLoop 重载）时自动使用同一个循环。
+    /// 未设置时只在入队与 flushIfDue 时检查时间阈值。事件循环须比套接字存活更久。
+    bool setFlushLoop(EventLoop &eventLoop);
+    /// @brief 开启/关闭内核接收时间戳（SO_TIMESTAMPNS）：开启后 PacketView::recvTime 为数据报到达协议栈的时间，
+    /// 并记录 udp.<本端地址>.recv.kernel_to_user_ns（到达到交给回调前的排队时间）；关闭或内核不支持时为用户态收取时间
+    bool setRecvTimestamps(bool enable);
     bool recv(RecvCallback recvCallback);
+    bool recvBatch(BatchRecvCallback batchCallback, int batchSize = defaultRecvBatchSize);
+    bool recv(RecvCallback recvCallback, EventLoop &eventLoop);                                                ///< 由事件循环接收，不单独起线程
+    bool recvBatch(BatchRecvCallback batchCallback, EventLoop &eventLoop, int batchSize = defaultRecvBatchSize); ///< 同上，批量回调
     bool recvSwitch(bool rSwitch);
     bool sockClose();
     ~UdpSocket();
@@ -98,9 +139,67 @@ private:
     sockaddr_in serverAddr, clientAddr;
     ip_mreq mreq;
     std::unique_ptr<SocketStrategyBase> socketStrategy;
+    SendQueue sendQueue;
+    std::mutex sendQueueMutex;      ///< 入队与定时刷新分属调用方线程与循环线程，发送队列的访问都在其下
+    int flushTimerFd = -1;          ///< 定时刷新用的 timerfd，未设置刷新事件循环时为 -1
+    EventLoop *flushLoop = nullptr; ///< flushTimerFd 注册到的事件循环
+    EventLoop *eventLoop = nullptr; ///< 注册到的事件循环，未注册时为空
+    int flushQueue();               ///< 发送队列中所有数据报，调用方持有 sendQueueMutex
+    void armFlushTimer();           ///< 按时间阈值定时一次，调用方持有 sendQueueMutex
+    void stopFlushTimer();          ///< 从事件循环移除并关闭 timerfd
     bool bind(const std::string &ip, int port) override;
     bool bind(UdpModel udpModel, const std::string &ip, int port);
 };
+/// @brief 分片接收的选项
+struct ShardOptions
+{
+    size_t shardCount = 0;     ///< 分片（套接字与接收线程）个数，0 为 CPU 核数
+    std::vector<int> cpus;     ///< 第 i 个分片的接收线程绑定到 cpus[i % cpus.size()]，为空时不绑定
+    bool cpuSteering = false;  ///< 附加按收包 CPU 选择分片的 BPF 程序，见 ShardedUdpSocket
+    bool recvTimestamps = false; ///< 各分片开启 SO_TIMESTAMPNS，见 UdpSocket::setRecvTimestamps
+    int batchSize = defaultRecvBatchSize;
+};
+
+/// @brief 分片 UDP 接收：在同一 ip:端口 上以 SO_REUSEPORT 打开多个套接字，每个套接字一个接收线程，
+/// 内核按四元组散列（或 cpuSteering 时按收包 CPU）把数据报分到各套接字，使一个端口的接收分摊到多个核上。
+/// cpuSteering 时第 i 个分片接收在 CPU i（模分片数）上进入协议栈的数据报，未指定 cpus 时第 i 个接收线程绑定到 CPU i，
+/// 网卡各接收队列的中断应分布在这些 CPU 上，数据报便从中断到回调都留在同一个核上。
+/// 回调在各分片线程上并发执行：交给 ProtocolManager 时应先 startWorkers（解析线程队列为多生产者），
+/// 或在回调中使用各分片自己的解析器。指标名为 udp.<本端地址>.recv.shard<i>.*。
+class ShardedUdpSocket
+{
+public:
+    /// @param port 为 0 时由第一个套接字取得临时端口，其余套接字绑定到同一端口，见 port()
+    ShardedUdpSocket(const std::string &ip, int port, const ShardOptions &shard_options = {});
+    ~ShardedUdpSocket();
+    ShardedUdpSocket(const ShardedUdpSocket &) = delete;
+    ShardedUdpSocket &operator=(const ShardedUdpSocket &) = delete;
+
+    bool recv(RecvCallback recvCallback);
+    bool recvBatch(BatchRecvCallback batchCallback); ///< 启动各分片的接收线程
+    void stop();                                     ///< 停止接收线程并关闭所有分片，之后不可再接收
+    size_t shardCount() const { return shards.size(); } ///< 成功打开的分片数，创建失败时为 0
+    int port() const { return boundPort; }
+
+private:
+    struct Shard
+    {
+        int fd = -1;
+        std::unique_ptr<PacketBatch> batch;
+        std::thread thread;
+        StageMetrics recvMetrics;
+        LatencyHistogram *kernelDelay = nullptr;
+    };
+
+    bool attachCpuSteering();
+    void receiveLoop(Shard &shard, int cpu, const BatchRecvCallback &batchCallback);
+
+    ShardOptions options;
+    std::vector<std::unique_ptr<Shard>> shards;
+    int boundPort = 0;
+    std::atomic<bool> running{false};
+};
+
 class UdpFactory
 {
 public:
@@ -118,6 +217,11 @@ public:
     {
         return std::make_unique<UdpSocket>(udpModel, ip, port);
     }
+
+    static inline std::unique_ptr<ShardedUdpSocket> createShardedUdpSocket(const std::string &ip, int port, const ShardOptions &shard_options = {})
+    {
+        return std::make_unique<ShardedUdpSocket>(ip, port, shard_options);
+    }
 };
 
 class TCPStrategyBase
@@ -126,10 +230,16 @@ public:
     virtual ~TCPStrategyBase() = default;
     virtual bool connect(TcpSocketInfo &socketInfo) = 0;
     virtual int send(TcpSocketInfo &socketInfo, const std::string &message) = 0;
-    virtual int recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize) = 0;
+    /// eventLoop 为空时启动独立接收线程，否则注册到事件循环上由其线程接收
+    virtual int recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize, EventLoop *eventLoop) = 0;
     virtual bool close(TcpSocketInfo &socketInfo) = 0;
     virtual bool bind(TcpSocketInfo &socketInfo) = 0;
     virtual bool recvSwitch(bool rSwitch) = 0;
+    virtual int sendTo(uint64_t connId, const std::string &message) = 0;
+    virtual int broadcast(const std::string &message) = 0;
+    virtual bool closeConnection(uint64_t connId) = 0;
+    virtual std::vector<TcpConnectionStat> connections() = 0;
+    virtual void setCloseCallback(StreamCloseCallback closeCallback) = 0;
 };
 
 class TCPServerStrategy : public TCPStrategyBase
@@ -137,16 +247,51 @@ class TCPServerStrategy : public TCPStrategyBase
 public:
     bool connect(TcpSocketInfo &socketInfo) override;
     int send(TcpSocketInfo &socketInfo, const std::string &message) override;
-    int recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize) override;
+    int recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize, EventLoop *eventLoop) override;
     bool close(TcpSocketInfo &socketInfo) override;
     bool bind(TcpSocketInfo &socketInfo) override;
     bool recvSwitch(bool rSwitch) override;
+    int sendTo(uint64_t connId, const std::string &message) override;
+    int broadcast(const std::string &message) override;
+    bool closeConnection(uint64_t connId) override;
+    std::vector<TcpConnectionStat> connections() override;
+    void setCloseCallback(StreamCloseCallback closeCallback) override;
     ~TCPServerStrategy();
 
+    /// @brief 服务端的一条连接
+    struct Connection
+    {
+        uint64_t connId = 0;
+        int fd = -1;          ///< 关闭后置为 -1，修改与接收线程外的使用都在 sendMutex 下
+        AddrInfo peer;
+        ReceiveSlot buffer;   ///< 接收缓冲区，取自共用缓冲池，被回调持有时下次读取前换新
+        std::mutex sendMutex; ///< 串行化同一连接上的发送与 fd 的关闭
+        std::atomic<uint64_t> bytesReceived{0};
+        std::atomic<uint64_t> bytesSent{0};
+        std::atomic<uint64_t> recvCount{0};
+        PacketView::Clock::time_point connectedTime;
+    };
+
+    /// @brief 连接表与接收状态，由接收线程/事件循环回调共享持有，strategy 析构后仍可安全访问
+    struct ServerState
+    {
+        std::mutex connMutex;
+        std::map<uint64_t, std::shared_ptr<Connection>> connTable; ///< 连接ID到连接
+        std::atomic<uint64_t> nextConnId{1};
+        std::atomic<uint64_t> lastConnId{0}; ///< 最近接入的连接，send() 发往该连接
+        std::atomic<bool> recvFlag{false};
+        EventLoop *eventLoop = nullptr;
+        int listenFd = -1;
+        RecvCallback recvCallback;
+        StreamCloseCallback closeCallback; ///< 连接从连接表摘除、fd 关闭后调用，每条连接一次
+        int bufferSize = 4096;
+        StageMetrics recvMetrics; ///< tcp.<监听地址>.recv，所有连接累加；latency 为接收回调的处理耗时
+        LatencyHistogram *kernelDelay = nullptr; ///< 内核时间戳到用户态收取的间隔，只在开启 SO_TIMESTAMPNS 时记录
+    };
+
 private:
-    std::string buffer;
-    std::unique_ptr<std::thread> recvThread;
-    std::atomic<bool> recvFlag;
+    std::shared_ptr<ServerState> state = std::make_shared<ServerState>();
+    std::unique_ptr<std::thread> recvThread; ///< 线程模式下的 accept 线程
 };
 
 class TCPClientStrategy : public TCPStrategyBase
@@ -154,28 +299,50 @@ class TCPClientStrategy : public TCPStrategyBase
 public:
     bool connect(TcpSocketInfo &socketInfo) override;
     int send(TcpSocketInfo &socketInfo, const std::string &message) override;
-    int recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize) override;
+    int recv(TcpSocketInfo &socketInfo, RecvCallback recvCallback, const int bufferSize, EventLoop *eventLoop) override;
     bool close(TcpSocketInfo &socketInfo) override;
     bool bind(TcpSocketInfo &socketInfo) override;
     bool recvSwitch(bool rSwitch) override;
+    int sendTo(uint64_t connId, const std::string &message) override;
+    int broadcast(const std::string &message) override;
+    bool closeConnection(uint64_t connId) override;
+    std::vector<TcpConnectionStat> connections() override;
+    void setCloseCallback(StreamCloseCallback closeCallback) override;
     ~TCPClientStrategy();
 
 private:
-    std::string buffer;
+    ReceiveSlot buffer; ///< 接收缓冲区，取自共用缓冲池
+    StreamCloseCallback closeCallback; ///< 事件循环模式下服务端关闭或 close() 时以 streamId 0 调用
     std::unique_ptr<std::thread> recvThread;
+    StageMetrics recvMetrics; ///< tcp.client.<服务端地址>.recv
+    LatencyHistogram *kernelDelay = nullptr;
 };
 class TcpSocket
 {
 private:
     TcpSocketInfo socketInfo;
     std::unique_ptr<TCPStrategyBase> strategy;
+    EventLoop *eventLoop = nullptr; ///< 注册到的事件循环，未注册时为空
+
+    void detachLoop();
 
 public:
     TcpSocket(TcpModel tcpModel, const std::string &ip, int port);
     bool connect(const std::string &ip, uint16_t port);
-    int send(const std::string &message);
+    int send(const std::string &message);                     ///< 客户端发往服务端；服务端发往最近接入的连接
+    int sendTo(uint64_t connId, const std::string &message);   ///< 服务端：发往指定连接
+    int broadcast(const std::string &message);                 ///< 服务端：发往所有连接，返回发送成功的连接数
+    bool closeConnection(uint64_t connId);                     ///< 服务端：关闭指定连接
+    std::vector<TcpConnectionStat> connections();              ///< 服务端：当前连接表快照
+    /// @brief 设置流关闭回调，应在 recv 之前设置。服务端每条连接关闭（对端关闭、出错、closeConnection、close）时调用一次；
+    /// 客户端在事件循环模式下服务端关闭或 close() 时调用，streamId 为 0
+    void setCloseCallback(StreamCloseCallback closeCallback);
     int recv(RecvCallback recvCallback);
-    bool recvSwitch(bool rSwitch);
+    int recv(RecvCallback recvCallback, EventLoop &eventLoop); ///< 由事件循环接收，不单独起线程
+    bool recvSwitch(bool rSwitch); ///< 服务端在事件循环上暂停/恢复接收（连接保留，不再关注可读）；客户端只能关闭，从事件循环移除
+    /// @brief 同 UdpSocket::setRecvTimestamps；服务端应在 recv 之前开启，之后接入的连接继承该选项。
+    /// 流套接字一次读取可能合并多个报文段，时间戳为其中最后到达的报文段的时间
+    bool setRecvTimestamps(bool enable);
     bool close();
     ~TcpSocket();
 };
@@ -192,3 +359,4 @@ public:
         return std::make_unique<TcpSocket>(TcpModel::tm_client, ip, port);
     }
 };
+#endif
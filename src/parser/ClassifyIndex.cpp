@@ -0,0 +1,131 @@
+#include "ClassifyIndex.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t denseMinSpan = 1024; ///< 键跨度不超过 max(该值, 消息数*4) 时使用跳转表
+}
+
+ClassifyIndex::ClassifyIndex(const nlohmann::json &rule)
+{
+    auto classify = rule.find("classify");
+    if (classify == rule.end())
+        return;
+
+    int totalWidth = 0;
+    for (const auto &t_item : classify->at("fields"))
+    {
+        // 与 filter 共用字段编译，未写 type 时按 uint
+        auto t_spec = t_item;
+        if (!t_spec.contains("type"))
+            t_spec["type"] = "uint";
+        auto t_field = RuleProgram::compileField(t_spec);
+        if (t_field.type != FieldType::FT_UInt && t_field.type != FieldType::FT_Bits)
+            throw std::runtime_error("Classify field must be uint or bits");
+        // 键中占的位数：没有掩码时为整个字段，否则到掩码的最高位为止
+        int t_width = t_field.mask == ~uint64_t(0) ? t_field.length * 8 : (t_field.mask ? 64 - __builtin_clzll(t_field.mask) : 1);
+        totalWidth += t_width;
+        this->minLength = std::max<size_t>(this->minLength, size_t(t_field.offset) + t_field.length);
+        this->discriminators.push_back(t_field);
+        this->widths.push_back(static_cast<uint8_t>(t_width));
+    }
+    if (this->discriminators.empty())
+        throw std::runtime_error("Protocol rule \"classify\" needs at least one field");
+    if (totalWidth > 64)
+        throw std::runtime_error("Classify fields are wider than 64 bits");
+
+    auto messages = rule.find("messages");
+    if (messages == rule.end() || !messages->is_array())
+        throw std::runtime_error("Protocol rule \"classify\" needs a \"messages\" array");
+    for (const auto &t_item : *messages)
+    {
+        MessageType t_message;
+        t_message.name = t_item.at("name").get<std::string>();
+        t_message.index = static_cast<uint32_t>(this->messageTypes.size());
+        auto t_id = t_item.find("id");
+        if (t_id != t_item.end())
+        {
+            // 与 keyOf 相同的拼接方式
+            auto t_parts = t_id->is_array() ? *t_id : nlohmann::json::array({*t_id});
+            if (t_parts.size() != this->discriminators.size())
+                throw std::runtime_error("Message \"" + t_message.name + "\" id does not match classify fields");
+            for (size_t i = 0; i < t_parts.size(); i++)
+            {
+                auto t_val = RuleProgram::toUInt(t_parts[i]);
+                if ((t_val & this->discriminators[i].mask) != t_val || (this->widths[i] < 64 && (t_val >> this->widths[i])))
+                    throw std::runtime_error("Message \"" + t_message.name + "\" id does not fit its classify field");
+                t_message.key = this->widths[i] == 64 ? t_val : (t_message.key << this->widths[i]) | t_val;
+            }
+            t_message.hasKey = true;
+        }
+        this->messageTypes.push_back(std::move(t_message));
+    }
+
+    auto defaultName = classify->value("default", "");
+    if (!defaultName.empty())
+    {
+        auto it = std::find_if(this->messageTypes.begin(), this->messageTypes.end(), [&](const MessageType &t_message)
+                               { return t_message.name == defaultName; });
+        if (it == this->messageTypes.end())
+            throw std::runtime_error("Classify default message not found: " + defaultName);
+        this->defaultIndex = static_cast<int>(it->index);
+    }
+    this->build();
+}
+
+void ClassifyIndex::build()
+{
+    std::vector<const MessageType *> keyed;
+    for (const auto &t_message : this->messageTypes)
+    {
+        if (t_message.hasKey)
+            keyed.push_back(&t_message);
+    }
+    if (keyed.empty())
+        return;
+
+    auto [minIt, maxIt] = std::minmax_element(keyed.begin(), keyed.end(), [](const MessageType *a, const MessageType *b)
+                                              { return a->key < b->key; });
+    auto span = (*maxIt)->key - (*minIt)->key;
+    if (span < std::max(denseMinSpan, keyed.size() * 4))
+    {
+        this->dense = true;
+        this->minKey = (*minIt)->key;
+        this->jumpTable.assign(span + 1, -1);
+        for (const auto *t_message : keyed)
+        {
+            auto &t_slot = this->jumpTable[t_message->key - this->minKey];
+            if (t_slot >= 0)
+                throw std::runtime_error("Duplicate message id for \"" + t_message->name + "\"");
+            t_slot = static_cast<int32_t>(t_message->index);
+        }
+        return;
+    }
+
+    // 容量取不小于两倍消息数的 2 的幂，线性探测的平均探测长度接近 1
+    size_t capacity = 2;
+    int bits = 1;
+    while (capacity < keyed.size() * 2)
+    {
+        capacity <<= 1;
+        bits++;
+    }
+    this->hashShift = 64 - bits;
+    this->buckets.assign(capacity, Bucket{});
+    for (const auto *t_message : keyed)
+    {
+        for (auto pos = (t_message->key * hashMultiplier) >> this->hashShift;; pos = (pos + 1) & (capacity - 1))
+        {
+            auto &t_bucket = this->buckets[pos];
+            if (t_bucket.index >= 0 && t_bucket.key == t_message->key)
+                throw std::runtime_error("Duplicate message id for \"" + t_message->name + "\"");
+            if (t_bucket.index < 0)
+            {
+                t_bucket.key = t_message->key;
+                t_bucket.index = static_cast<int32_t>(t_message->index);
+                break;
+            }
+        }
+    }
+}
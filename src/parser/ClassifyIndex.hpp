@@ -0,0 +1,106 @@
+#ifndef _ClassifyIndex_hpp_
+#define _ClassifyIndex_hpp_
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "RuleProgram.hpp"
+
+/// @brief 规则 "messages" 中的一种消息类型
+struct MessageType
+{
+    std::string name; ///< 消息名称
+    uint64_t key = 0;    ///< 判别字段拼接成的键
+    bool hasKey = false; ///< 没有 id 的消息只能作为 default
+    uint32_t index = 0;  ///< 在 messages 中的下标
+};
+
+/// @brief 消息分类索引，构造时把判别字段与消息ID编译成查找表，逐包分类只做一次查找
+/// 规则格式：
+///   "classify": {"fields": [{"offset": 4, "length": 2, "endian": "big", "mask": ..}, ...],
+///                "default": "unknown"}
+/// 判别字段按 filter 的字段格式编译（见 RuleProgram::compileField），type 只能是 uint 系列或 bits，缺省为 uint；
+/// 位字段写 "type": "bits" 与 bit-offset/bit-length。
+///   "messages": [{"name": "login", "id": 1}, {"name": "data", "id": [2, 7]}, {"name": "unknown"}, ...]
+/// default 为未命中时归入的消息名称，该消息可以没有 id。
+/// 多个判别字段时 id 为数组，按字段顺序依次拼接（先出现的字段在高位），总宽度不超过 64 位。
+/// 键分布紧凑时使用跳转表（键减最小键直接作下标），否则使用容量不小于消息数两倍的开放定址散列表。
+class ClassifyIndex
+{
+public:
+    ClassifyIndex() = default;
+    /// @brief 编译 rule 中的 classify 与 messages，规则不合法或 ID 重复时抛出 std::runtime_error
+    explicit ClassifyIndex(const nlohmann::json &rule);
+
+    /// @brief 数据包所属的消息类型下标，未命中且没有 default 时返回 -1，包长不足也返回 -1
+    int classify(const uint8_t *data, size_t length) const
+    {
+        if (this->discriminators.empty() || length < this->minLength)
+            return -1;
+        auto index = this->find(this->keyOf(data));
+        return index >= 0 ? index : this->defaultIndex;
+    }
+
+    /// @brief 按判别字段拼出键；调用方保证包长不小于 minLength
+    uint64_t keyOf(const uint8_t *data) const
+    {
+        uint64_t key = 0;
+        for (size_t i = 0; i < this->discriminators.size(); i++)
+        {
+            const auto &t_field = this->discriminators[i];
+            auto t_val = (RuleProgram::loadRaw(t_field, data) >> t_field.shift) & t_field.mask;
+            key = this->widths[i] == 64 ? t_val : (key << this->widths[i]) | t_val;
+        }
+        return key;
+    }
+
+    /// @brief 按键查找消息类型下标，不存在返回 -1
+    int find(uint64_t key) const
+    {
+        if (this->dense)
+        {
+            auto offset = key - this->minKey;
+            return offset < this->jumpTable.size() ? this->jumpTable[offset] : -1;
+        }
+        if (this->buckets.empty())
+            return -1;
+        auto mask = this->buckets.size() - 1;
+        for (auto pos = (key * hashMultiplier) >> this->hashShift;; pos = (pos + 1) & mask)
+        {
+            const auto &t_bucket = this->buckets[pos];
+            if (t_bucket.index < 0 || t_bucket.key == key)
+                return t_bucket.index;
+        }
+    }
+
+    bool empty() const { return this->discriminators.empty(); }
+    const std::vector<MessageType> &messages() const { return messageTypes; }
+    bool isDense() const { return dense; } ///< 是否使用跳转表
+    int defaultMessage() const { return defaultIndex; }                           ///< 未命中时归入的消息类型，没有为 -1
+    const std::vector<FieldDescriptor> &fields() const { return discriminators; } ///< 判别字段
+    const std::vector<uint8_t> &fieldWidths() const { return widths; }            ///< 各判别字段在键中的位宽
+    size_t requiredLength() const { return minLength; }                           ///< 读取所有判别字段需要的最小包长
+
+private:
+    struct Bucket
+    {
+        uint64_t key = 0;
+        int32_t index = -1; ///< -1 为空槽
+    };
+
+    static constexpr uint64_t hashMultiplier = 0x9E3779B97F4A7C15ull; ///< 斐波那契散列，取乘积高位作下标
+    void build(); ///< 由 messageTypes 生成跳转表或散列表
+
+    std::vector<FieldDescriptor> discriminators; ///< 判别字段
+    std::vector<uint8_t> widths;                 ///< 各判别字段的位宽
+    size_t minLength = 0;                        ///< 读取所有判别字段需要的最小包长
+    std::vector<MessageType> messageTypes;
+    int defaultIndex = -1; ///< 未命中时归入的消息类型
+
+    bool dense = false;
+    uint64_t minKey = 0;
+    std::vector<int32_t> jumpTable; ///< dense 时使用，下标为 key - minKey
+    std::vector<Bucket> buckets;    ///< 非 dense 时使用，容量为 2 的幂
+    int hashShift = 64;             ///< 64 - log2(容量)
+};
+#endif
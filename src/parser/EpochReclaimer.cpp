@@ -0,0 +1,30 @@
+#include "EpochReclaimer.hpp"
+#include <thread>
+
+size_t EpochReclaimer::threadStripe()
+{
+    static std::atomic<size_t> nextStripe{0};
+    thread_local size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % stripeCount;
+    return stripe;
+}
+
+void EpochReclaimer::synchronize()
+{
+    std::lock_guard<std::mutex> lock(this->writerMutex);
+    // 翻转两次：第一次等待翻转前按旧奇偶进入的读者离开；
+    // 第二次等待在更早的翻转前读到奇偶、却晚于上次等待才计数的读者离开
+    for (int round = 0; round < 2; round++)
+    {
+        auto parity = this->epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+        for (auto &t_stripe : this->stripes)
+        {
+            int spins = 0;
+            while (t_stripe.active[parity].load(std::memory_order_seq_cst) != 0)
+            {
+                if (++spins < 128)
+                    continue;
+                std::this_thread::yield();
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef _EpochReclaimer_hpp_
+#define _EpochReclaimer_hpp_
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/// @brief 轻量的 epoch 回收，用于无锁替换被多个线程读取的对象（思路同 userspace RCU 的双计数翻转）
+/// 读者用 pin() 进入读区：只在本线程所在条带的计数上做一次原子加，离开时减一，互不争用同一缓存行；
+/// 写者先原子替换指针，再调用 synchronize() 等待替换前进入读区的读者全部离开，之后即可释放旧对象。
+/// 读者应在 pin() 之后以 seq_cst 读取被保护的指针；不可在读区内调用 synchronize()，否则自身永远等不到。
+class EpochReclaimer
+{
+public:
+    /// @brief 读区守卫，析构时离开读区
+    class Guard
+    {
+    public:
+        Guard(Guard &&other) noexcept : counter(other.counter) { other.counter = nullptr; }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+        ~Guard()
+        {
+            if (this->counter)
+                this->counter->fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        friend class EpochReclaimer;
+        explicit Guard(std::atomic<uint64_t> *counter) : counter(counter) {}
+        std::atomic<uint64_t> *counter;
+    };
+
+    /// @brief 进入读区
+    Guard pin()
+    {
+        auto &stripe = this->stripes[threadStripe()];
+        auto &counter = stripe.active[this->epoch.load(std::memory_order_relaxed) & 1];
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        return Guard(&counter);
+    }
+
+    /// @brief 等待一个宽限期：调用前已进入读区的读者都已离开；多个写者之间串行
+    void synchronize();
+
+private:
+    static constexpr size_t stripeCount = 64;
+    static size_t threadStripe(); ///< 当前线程使用的条带，线程首次调用时按序分配
+
+    struct alignas(64) Stripe
+    {
+        std::atomic<uint64_t> active[2] = {0, 0}; ///< 按 epoch 奇偶分开的读者计数
+    };
+
+    std::array<Stripe, stripeCount> stripes;
+    std::atomic<uint64_t> epoch{0};
+    std::mutex writerMutex;
+};
+#endif
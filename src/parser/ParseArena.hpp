@@ -0,0 +1,76 @@
+#ifndef _ParseArena_hpp_
+#define _ParseArena_hpp_
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/// @brief 解析结果的线性分配器
+/// 按块向后切分内存，reset() 只把位置拨回开头而不归还内存，一批数据包解析完后整体复用；
+/// 稳态下（每批需要的总量不再增长）不再向系统申请内存。只能存放平凡析构的类型。
+class ParseArena
+{
+public:
+    explicit ParseArena(size_t chunk_size = 64 * 1024) : chunkSize(chunk_size) {}
+    ParseArena(const ParseArena &) = delete;
+    ParseArena &operator=(const ParseArena &) = delete;
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        while (this->current < this->chunks.size())
+        {
+            auto &chunk = this->chunks[this->current];
+            auto base = reinterpret_cast<uintptr_t>(chunk.data.get());
+            auto pos = (base + this->used + align - 1) & ~(uintptr_t(align) - 1);
+            if (pos + size <= base + chunk.size)
+            {
+                this->used = pos + size - base;
+                return reinterpret_cast<void *>(pos);
+            }
+            // 当前块放不下，换下一块；超大的请求在后面单独追加一块
+            this->current++;
+            this->used = 0;
+        }
+        auto t_size = std::max(this->chunkSize, size + align);
+        this->chunks.push_back({std::make_unique<uint8_t[]>(t_size), t_size});
+        this->used = 0;
+        return this->allocate(size, align);
+    }
+
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "ParseArena never runs destructors");
+        return static_cast<T *>(this->allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /// @brief 丢弃所有已分配的对象，保留内存
+    void reset()
+    {
+        this->current = 0;
+        this->used = 0;
+    }
+
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (const auto &t_chunk : this->chunks)
+            total += t_chunk.size;
+        return total;
+    }
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    size_t chunkSize;
+    std::vector<Chunk> chunks;
+    size_t current = 0; ///< 正在切分的块
+    size_t used = 0;    ///< 当前块已用字节数
+};
+#endif
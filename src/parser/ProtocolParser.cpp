@@ -1,12 +1,28 @@
 #include "ProtocolParser.hpp"
+#include "SockKit.hpp"
+#include "StreamFramer.hpp"
+
+ProtocolManager::ProtocolManager()
+{
+    this->setMetricsName("protocol");
+}
+
+ProtocolManager::~ProtocolManager()
+{
+    this->stopWorkers();
+}
 
 bool ProtocolManager::append(const std::string &ParserName, std::shared_ptr<ProtocolParser> newProtocolParser)
 {
-    return this->protocolParserPool[ParserName] = newProtocolParser;
+    if (!newProtocolParser)
+        return false;
+    // 同名解析器已存在时等同于 swap
+    return this->swap(ParserName, std::move(newProtocolParser));
 }
 
 bool ProtocolManager::select(const std::string &ParserName)
 {
+    std::lock_guard<std::mutex> lock(this->swapMutex);
     auto it = this->protocolParserPool.find(ParserName);
     if (it != this->protocolParserPool.end() && it->second != nullptr)
     {
@@ -19,26 +35,125 @@ bool ProtocolManager::select(const std::string &ParserName)
 
 void ProtocolManager::clear()
 {
-    this->protocolParserPool.clear();
+    std::map<std::string, std::shared_ptr<ProtocolParser>> retired;
+    {
+        std::lock_guard<std::mutex> lock(this->swapMutex);
+        retired.swap(this->protocolParserPool);
+        this->curProtocolParser = nullptr;
+    }
+    this->parserEpoch.synchronize();
 }
 
 void ProtocolManager::clear(const std::string &ParserName)
 {
-    auto it = this->protocolParserPool.find(ParserName);
-    if (it != this->protocolParserPool.end())
+    std::shared_ptr<ProtocolParser> retired;
     {
+        std::lock_guard<std::mutex> lock(this->swapMutex);
+        auto it = this->protocolParserPool.find(ParserName);
+        if (it == this->protocolParserPool.end())
+            return;
         if (this->curProtocolParser == it->second.get())
         {
             this->curProtocolParser = nullptr;
         }
+        retired = std::move(it->second);
         this->protocolParserPool.erase(it);
     }
+    this->parserEpoch.synchronize();
+}
+
+bool ProtocolManager::swap(const std::string &ParserName, std::shared_ptr<ProtocolParser> newProtocolParser)
+{
+    if (!newProtocolParser)
+        return false;
+    std::shared_ptr<ProtocolParser> retired;
+    {
+        std::lock_guard<std::mutex> lock(this->swapMutex);
+        auto &slot = this->protocolParserPool[ParserName];
+        if (slot == newProtocolParser)
+            return true;
+        if (!this->attachCallbacks(*newProtocolParser))
+        {
+            if (!slot)
+                this->protocolParserPool.erase(ParserName);
+            return false;
+        }
+        retired = std::exchange(slot, newProtocolParser);
+        if (retired && this->curProtocolParser == retired.get())
+            this->curProtocolParser = newProtocolParser.get();
+    }
+    if (!retired)
+        return true;
+    // 旧实例在宽限期结束、所有正在用它解析的线程返回后随 retired 释放
+    this->parserEpoch.synchronize();
+    return true;
+}
+
+bool ProtocolManager::swapRules(const std::string &ParserName, const json &rule)
+{
+    auto newProtocolParser = std::make_shared<JsonProtocolParser>(rule);
+    if (!this->swap(ParserName, newProtocolParser))
+        return false;
+    if (!this->activeWorkers.load())
+        return true;
+    return this->swapWorkers([rule]()
+                             { return std::make_shared<JsonProtocolParser>(rule); });
+}
+
+bool ProtocolManager::swapWorkers(ParserFactory factory)
+{
+    if (!factory)
+        return false;
+    std::vector<std::shared_ptr<ProtocolParser>> retired;
+    {
+        std::lock_guard<std::mutex> lock(this->swapMutex);
+        if (!this->workerSet)
+            return true;
+        auto &workers = this->workerSet->workers;
+        // 先全部构造成功再切换，避免部分线程用新规则、部分线程用旧规则
+        std::vector<std::shared_ptr<ProtocolParser>> created;
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            created.push_back(factory());
+            if (!created.back() || !this->attachCallbacks(*created.back()))
+                return false;
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            auto &t_worker = *workers[i];
+            t_worker.current = created[i].get();
+            retired.push_back(std::exchange(t_worker.parser, std::move(created[i])));
+        }
+    }
+    this->parserEpoch.synchronize();
+    return true;
 }
-void ProtocolManager::parse(const std::string &data)
+
+void ProtocolManager::enqueue(WorkerSet &workers, const PacketView &packet)
+{
+    // 斐波那契散列把流标识打散到各解析线程
+    auto index = ((workers.flowKey(packet) * 0x9E3779B97F4A7C15ull) >> 32) % workers.workers.size();
+    if (!workers.workers[index]->ring->push(packet))
+        this->parseMetrics.dropped->add();
+}
+
+void ProtocolManager::parse(const PacketView &packet)
 {
-    if (this->curProtocolParser)
+    // 读区同时保护线程池：stopWorkers 摘下线程池后等宽限期结束才销毁
+    auto guard = this->parserEpoch.pin();
+    if (auto *workers = this->activeWorkers.load())
     {
-        this->curProtocolParser->parse(data);
+        this->enqueue(*workers, packet);
+        return;
+    }
+    if (auto *parser = this->curProtocolParser.load())
+    {
+        if (this->traceEnabled.load(std::memory_order_relaxed))
+            this->traceParse(packet, PacketView::Clock::now());
+        this->parseMetrics.packets->add();
+        this->parseMetrics.bytes->add(packet.length);
+        ScopedLatency latency(this->parseMetrics.latency);
+        parser->parse(packet);
     }
     else
     {
@@ -46,42 +161,367 @@ void ProtocolManager::parse(const std::string &data)
     }
 }
 
-JsonProtocolParser::JsonProtocolParser(const json &rule)
+bool ProtocolManager::attachCallbacks(ProtocolParser &parser) const
 {
-    this->parserRule = rule;
+    // 以结果开关判断是否已注册：同一实例再次 swap/append（换名或同名）时不能重复转发，
+    // 也不能修改可能正被其他线程解析的实例上的回调列表
+    if (parser.gate() == &this->hasCallbacks)
+        return true;
+    if (parser.gate())
+        return false;
+    // 解析器发布前注册，此后不再修改解析器上的回调；回调列表为空时 hasCallbacks 为 false，解析器据此跳过分类与解码
+    parser.addResultCallback([this](const ParseResult &result)
+                             { this->deliver(result); });
+    parser.setResultGate(&this->hasCallbacks);
+    return true;
+}
+
+int ProtocolManager::attachStream(TcpSocket &socket, const json &rule, EventLoop *eventLoop)
+{
+    // 分帧层由两个回调共同持有，随 socket 释放回调而释放
+    auto stage = std::make_shared<FramingStage>(rule, [this](const PacketView &frame)
+                                                {
+        try
+        {
+            this->parse(frame);
+        }
+        catch (const std::exception &)
+        {
+            this->parseMetrics.errors->add(); // 未选择解析器等，不让异常进入接收线程
+        } });
+    socket.setCloseCallback([stage](uint64_t streamId)
+                            { stage->closeStream(streamId); });
+    RecvCallback recvCallback = [stage](const PacketView &chunk)
+    { stage->feed(chunk); };
+    return eventLoop ? socket.recv(recvCallback, *eventLoop) : socket.recv(recvCallback);
 }
 
-void JsonProtocolParser::parse(const std::string &buffer)
+void ProtocolManager::addResultCallback(ResultCallback callback)
 {
-    this->parserRule["protocol-info"]["description"];
-    this->parserRule["protocol-info"]["version"];
-    std::cout << this->parserRule["protocol-info"]["name"] << std::endl;
+    std::shared_ptr<const ResultCallbackList> retired;
+    {
+        std::lock_guard<std::mutex> lock(this->swapMutex);
+        auto list = std::make_shared<ResultCallbackList>(*this->callbackList);
+        list->push_back(std::move(callback));
+        retired = std::exchange(this->callbackList, std::move(list));
+        this->resultCallbacks.store(this->callbackList.get());
+        this->hasCallbacks.store(true, std::memory_order_relaxed);
+    }
+    // 正在遍历旧列表的 deliver 都在 parse 的读区内，宽限期后旧列表随 retired 释放
+    this->parserEpoch.synchronize();
 }
 
-bool JsonProtocolParser::filter(const std::string &buffer)
+void ProtocolManager::parseBatch(const PacketView *packets, size_t count)
 {
-    json filter = this->parserRule["filter"];
-    auto res = true;
-    for (auto i = 0; i < filter.size(); i++)
+    auto guard = this->parserEpoch.pin();
+    if (auto *workers = this->activeWorkers.load())
+    {
+        for (size_t i = 0; i < count; i++)
+            this->enqueue(*workers, packets[i]);
+        return;
+    }
+    if (auto *parser = this->curProtocolParser.load())
     {
-        if (!filter[i]["enable"])
-            continue;
-        auto offset = filter[i]["offset"];
-        auto length = filter[i]["length"];
-        auto type = filter[i]["type"];
-        auto value = filter[i]["value"];
-        if (type == "int")
+        bool tracing = this->traceEnabled.load(std::memory_order_relaxed);
+        auto now = tracing ? PacketView::Clock::now() : PacketView::Clock::time_point{};
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < count; i++)
         {
-            auto val = static_cast<int>(buffer.data() + 30);
-            if (val == static_cast<int>(value))
+            bytes += packets[i].length;
+            if (tracing)
+                this->traceParse(packets[i], now);
+        }
+        this->parseMetrics.packets->add(count);
+        this->parseMetrics.bytes->add(bytes);
+        ScopedLatency latency(this->parseMetrics.latency);
+        parser->parseBatch(packets, count);
+    }
+    else
+    {
+        throw std::runtime_error("No protocol parser selected");
+    }
+}
+
+bool ProtocolManager::startWorkers(size_t worker_count, ParserFactory factory, FlowKeyFunc flow_key,
+                                   size_t queue_slots, RingFullPolicy full_policy, size_t slot_size, size_t max_packet_size)
+{
+    if (this->activeWorkers.load() || worker_count == 0 || !factory || !flow_key)
+        return false;
+    // 整个线程池构造完成后才发布，parse 要么看不到它，要么看到全部解析线程
+    auto workers = std::make_unique<WorkerSet>();
+    workers->flowKey = std::move(flow_key);
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        auto t_worker = std::make_unique<ParseWorker>();
+        t_worker->parser = factory();
+        if (!t_worker->parser)
+            return false; // 已创建的解析线程随 workers 析构退出
+        t_worker->current = t_worker->parser.get();
+        t_worker->ring = std::make_unique<MpscPacketRing>(queue_slots, slot_size, full_policy, max_packet_size);
+        auto *current = &t_worker->current;
+        t_worker->worker = std::make_unique<RingWorker<MpscPacketRing>>(*t_worker->ring, [this, current](const PacketView &packet)
+                                                                        {
+            if (this->traceEnabled.load(std::memory_order_relaxed))
+                this->traceParse(packet, PacketView::Clock::now());
+            this->parseMetrics.packets->add();
+            this->parseMetrics.bytes->add(packet.length);
+            try
             {
+                auto guard = this->parserEpoch.pin();
+                ScopedLatency latency(this->parseMetrics.latency);
+                current->load()->parse(packet);
             }
+            catch (const std::exception &)
+            {
+                this->parseErrors++;
+                this->parseMetrics.errors->add();
+            } });
+        workers->workers.push_back(std::move(t_worker));
+    }
+    std::lock_guard<std::mutex> lock(this->swapMutex);
+    if (this->workerSet)
+        return false; // 并发的 startWorkers 已先启动
+    // 解析线程在发布前不会收到数据包，此时注册回调不与解析并发
+    for (auto &t_worker : workers->workers)
+    {
+        if (!this->attachCallbacks(*t_worker->parser))
+            return false;
+    }
+    this->workerSet = std::move(workers);
+    this->activeWorkers.store(this->workerSet.get());
+    return true;
+}
+
+void ProtocolManager::stopWorkers()
+{
+    std::unique_ptr<WorkerSet> stopping;
+    {
+        std::lock_guard<std::mutex> lock(this->swapMutex);
+        stopping = std::move(this->workerSet);
+        this->activeWorkers.store(nullptr);
+    }
+    if (!stopping)
+        return;
+    // 等待仍在向旧线程池入队的 parse 返回；RingWorker 析构时会先消费完队列中剩余的数据包
+    this->parserEpoch.synchronize();
+    stopping.reset();
+}
+
+std::vector<PacketRingStats> ProtocolManager::workerStats() const
+{
+    std::vector<PacketRingStats> stats;
+    std::lock_guard<std::mutex> lock(this->swapMutex);
+    if (this->workerSet)
+    {
+        for (const auto &t_worker : this->workerSet->workers)
+            stats.push_back(t_worker->ring->stats());
+    }
+    return stats;
+}
+
+void ProtocolManager::setMetricsName(const std::string &name)
+{
+    auto &registry = MetricsRegistry::getInstance();
+    this->parseMetrics = registry.stage(name + ".parse", packetSampleEvery);
+    this->trace.recvToParse = &registry.histogram(name + ".trace.recv_to_parse_ns");
+    this->trace.recvToResult = &registry.histogram(name + ".trace.recv_to_result_ns");
+    this->trace.resultCallback = &registry.histogram(name + ".trace.result_callback_ns");
+}
+
+namespace
+{
+    uint64_t elapsedNs(PacketView::Clock::time_point since, PacketView::Clock::time_point now)
+    {
+        return now > since ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count() : 0;
+    }
+}
+
+void ProtocolManager::traceParse(const PacketView &packet, PacketView::Clock::time_point now) const
+{
+    if (packet.recvTime.time_since_epoch().count() != 0)
+        this->trace.recvToParse->record(elapsedNs(packet.recvTime, now));
+}
+
+void ProtocolManager::deliver(const ParseResult &result) const
+{
+    // 由解析器在 parse 的读区内调用，列表在宽限期之前不会被释放
+    const auto &callbacks = *this->resultCallbacks.load();
+    if (!this->traceEnabled.load(std::memory_order_relaxed) || !result.packet || result.packet->recvTime.time_since_epoch().count() == 0)
+    {
+        for (const auto &t_callback : callbacks)
+            t_callback(result);
+        return;
+    }
+    auto begin = PacketView::Clock::now();
+    this->trace.recvToResult->record(elapsedNs(result.packet->recvTime, begin));
+    for (const auto &t_callback : callbacks)
+        t_callback(result);
+    this->trace.resultCallback->record(elapsedNs(begin, PacketView::Clock::now()));
+}
+
+uint64_t ProtocolManager::sourceFlowKey(const PacketView &packet)
+{
+    auto key = std::hash<std::string_view>{}(packet.source.ip);
+    key ^= (static_cast<uint64_t>(packet.source.port) << 32) ^ packet.streamId;
+    return key;
+}
+
+FlowKeyFunc ProtocolManager::fieldFlowKey(const FieldDescriptor &field)
+{
+    auto minLength = size_t(field.offset) + field.length;
+    return [field, minLength](const PacketView &packet) -> uint64_t
+    {
+        return packet.length >= minLength ? RuleProgram::load(field, packet.data) : 0;
+    };
+}
+
+JsonProtocolParser::JsonProtocolParser(const json &rule) : ruleProgram(rule), classifyIndex(rule)
+{
+    auto &registry = MetricsRegistry::getInstance();
+    auto prefix = "parser." + (this->ruleProgram.name().empty() ? std::string("unnamed") : this->ruleProgram.name());
+    this->filterMetrics = registry.stage(prefix + ".filter", packetSampleEvery);
+    this->classifyMetrics = registry.stage(prefix + ".classify", packetSampleEvery);
+    this->decodeMetrics = registry.stage(prefix + ".decode", packetSampleEvery);
+
+    auto compileLayout = [](const std::string &name, const json &fields)
+    {
+        MessageLayout layout;
+        layout.name = name;
+        for (const auto &t_item : fields)
+        {
+            layout.fieldNames.push_back(t_item.at("name").get<std::string>());
+            layout.fields.push_back(RuleProgram::compileField(t_item));
+            layout.minLength = std::max<size_t>(layout.minLength, size_t(layout.fields.back().offset) + layout.fields.back().length);
         }
+        return layout;
+    };
+    if (this->classifyIndex.empty())
+    {
+        this->layouts.push_back(compileLayout("", rule.value("fields", json::array())));
+        return;
     }
-    return res;
+    for (const auto &t_item : rule.at("messages"))
+        this->layouts.push_back(compileLayout(t_item.at("name").get<std::string>(), t_item.value("fields", json::array())));
 }
 
-bool JsonProtocolParser::classify(const std::string &buffer)
+namespace
 {
+    // 每个解析线程一个，解析完一个包（parse）或一批包（parseBatch）后复位
+    ParseArena &threadArena()
+    {
+        thread_local ParseArena arena;
+        return arena;
+    }
+}
+
+void JsonProtocolParser::parse(const PacketView &packet)
+{
+    if (!this->filter(packet))
+        return;
+    auto &arena = threadArena();
+    arena.reset();
+    this->dispatch(packet, arena);
+}
+
+void JsonProtocolParser::dispatch(const PacketView &packet, ParseArena &arena)
+{
+    if (!this->wantsResults())
+        return;
+    int index = -1;
+    if (!this->classifyIndex.empty())
+    {
+        this->classifyMetrics.packets->add();
+        {
+            ScopedLatency latency(this->classifyMetrics.latency);
+            index = this->classify(packet);
+        }
+        if (index < 0)
+        {
+            this->classifyMetrics.dropped->add();
+            return;
+        }
+    }
+    const auto &layout = this->layouts[index < 0 ? 0 : index];
+    this->decodeMetrics.packets->add();
+    if (packet.length < layout.minLength)
+    {
+        this->decodeMetrics.dropped->add();
+        return;
+    }
+
+    ScopedLatency latency(this->decodeMetrics.latency); // 含结果回调的耗时
+    auto *fields = arena.allocateArray<FieldValue>(layout.fields.size());
+    for (size_t i = 0; i < layout.fields.size(); i++)
+    {
+        const auto &t_field = layout.fields[i];
+        auto &t_value = fields[i];
+        t_value.name = layout.fieldNames[i];
+        t_value.type = t_field.type;
+        t_value.bytes = {};
+        if (t_field.type == FieldType::FT_Bytes)
+        {
+            t_value.u = 0;
+            t_value.bytes = std::string_view(reinterpret_cast<const char *>(packet.data) + t_field.offset, t_field.length);
+        }
+        else
+        {
+            auto t_raw = RuleProgram::value(t_field, packet.data);
+            std::memcpy(&t_value.u, &t_raw, sizeof(t_raw)); // FT_Float 的位模式即 double
+        }
+    }
+
+    ParseResult result;
+    result.protocol = this->ruleProgram.name();
+    result.message = layout.name;
+    result.messageIndex = index;
+    result.packet = &packet;
+    result.fields = fields;
+    result.fieldCount = layout.fields.size();
+    this->emit(result);
+}
+
+void JsonProtocolParser::parseBatch(const PacketView *packets, size_t count)
+{
+    auto &arena = threadArena();
+    arena.reset(); // 本批所有结果在返回前一直有效
+    uint8_t matched[64];
+    for (size_t base = 0; base < count; base += sizeof(matched))
+    {
+        auto lanes = std::min(sizeof(matched), count - base);
+        this->filterMetrics.packets->add(lanes);
+        // 整组只计时一次，按组内包数折算成每包耗时
+        bool timed = this->filterMetrics.latency->sampled();
+        auto begin = timed ? ScopedLatency::Clock::now() : ScopedLatency::Clock::time_point{};
+        this->ruleProgram.matchBatch(packets + base, lanes, matched);
+        if (timed)
+            this->filterMetrics.latency->record(std::chrono::duration_cast<std::chrono::nanoseconds>(ScopedLatency::Clock::now() - begin).count() / lanes);
+        size_t rejected = 0;
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < lanes; i++)
+        {
+            bytes += packets[base + i].length;
+            if (matched[i])
+                this->dispatch(packets[base + i], arena);
+            else
+                rejected++;
+        }
+        this->filterMetrics.bytes->add(bytes);
+        this->filterMetrics.dropped->add(rejected);
+    }
+}
+
+bool JsonProtocolParser::filter(const PacketView &packet)
+{
+    this->filterMetrics.packets->add();
+    this->filterMetrics.bytes->add(packet.length);
+    ScopedLatency latency(this->filterMetrics.latency);
+    if (this->ruleProgram.match(packet.data, packet.length))
+        return true;
+    this->filterMetrics.dropped->add();
     return false;
 }
+
+int JsonProtocolParser::classify(const PacketView &packet) const
+{
+    return this->classifyIndex.classify(packet.data, packet.length);
+}
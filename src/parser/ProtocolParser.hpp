@@ -1,41 +1,227 @@
+#ifndef _ProtocolParser_hpp_
+#define _ProtocolParser_hpp_
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 #include <iostream>
+#include <functional>
 #include <nlohmann/json.hpp>
+#include "RuleProgram.hpp"
+#include "ClassifyIndex.hpp"
+#include "PacketView.hpp"
+#include "PacketRing.hpp"
+#include "EpochReclaimer.hpp"
+#include "ParseArena.hpp"
+#include "Metrics.hpp"
 using json = nlohmann::json;
 
+class TcpSocket;
+class EventLoop;
+
+/// @brief 解码出的单个字段，按 type 读取对应成员
+struct FieldValue
+{
+    std::string_view name; ///< 字段名，指向解析器编译后的规则，解析器存活期间有效
+    FieldType type;
+    union
+    {
+        int64_t i;  ///< FT_Int
+        uint64_t u; ///< FT_UInt、FT_Bits
+        double f;   ///< FT_Float
+    };
+    std::string_view bytes; ///< FT_Bytes，指向数据包内部
+};
+
+/// @brief 一个数据包的解析结果，字段数组分配在解析线程的 ParseArena 中，
+/// 与 packet 一样只在本批解析期间有效，需要保留的使用者自行拷贝
+struct ParseResult
+{
+    std::string_view protocol;  ///< 协议名称
+    std::string_view message;   ///< 消息类型名称，规则没有 classify 时为空
+    int messageIndex = -1;      ///< 消息类型在 messages 中的下标
+    const PacketView *packet = nullptr;
+    const FieldValue *fields = nullptr;
+    size_t fieldCount = 0;
+};
+
+/// 解析结果回调，在解析线程上调用
+using ResultCallback = std::function<void(const ParseResult &result)>;
+
 class ProtocolParser
 {
 public:
     virtual ~ProtocolParser() = default;
-    virtual void parse(const std::string &buffer) = 0;
+    /// 注册结果回调，应在开始解析前注册，不可与 parse 并发
+    void addResultCallback(ResultCallback callback) { resultCallbacks.push_back(std::move(callback)); }
+    /// 设置结果开关：gate 指向 false 时视同没有回调，解析器跳过分类与解码；由 ProtocolManager 在注册转发回调时设置
+    void setResultGate(const std::atomic<bool> *gate) { resultGate = gate; }
+    /// 当前的结果开关，为空时尚未被 ProtocolManager 注册
+    const std::atomic<bool> *gate() const { return resultGate; }
+    /// packet 为非拥有视图，解析器只能在调用期间访问其数据
+    virtual void parse(const PacketView &packet) = 0;
+    /// 批量解析，缺省逐包调用 parse；解析器可覆盖它做批量过滤
+    virtual void parseBatch(const PacketView *packets, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            this->parse(packets[i]);
+    }
+
+protected:
+    /// 是否有使用者需要解析结果，没有时解析器只做过滤
+    bool wantsResults() const
+    {
+        return !this->resultCallbacks.empty() && (!this->resultGate || this->resultGate->load(std::memory_order_relaxed));
+    }
+
+    void emit(const ParseResult &result) const
+    {
+        for (const auto &t_callback : this->resultCallbacks)
+            t_callback(result);
+    }
+
+    std::vector<ResultCallback> resultCallbacks;
+    const std::atomic<bool> *resultGate = nullptr;
 };
 
 class JsonProtocolParser : public ProtocolParser
 {
 public:
     JsonProtocolParser(const json &rule);
-    void parse(const std::string &buffer) override;
+    void parse(const PacketView &packet) override;
+    void parseBatch(const PacketView *packets, size_t count) override; ///< 整批先经 RuleProgram::matchBatch 过滤
+
+    const ClassifyIndex &classifier() const { return classifyIndex; }
 
 private:
-    bool filter(const std::string &buffer);
-    bool classify(const std::string &buffer);
+    /// 一种消息的字段布局，规则中 messages[i].fields（没有 classify 时为顶层 fields）
+    struct MessageLayout
+    {
+        std::string name;
+        std::vector<std::string> fieldNames;
+        std::vector<FieldDescriptor> fields;
+        size_t minLength = 0; ///< 解码所有字段需要的最小包长，不足的包不产生结果
+    };
+
+    bool filter(const PacketView &packet);
+    /// 数据包的消息类型下标，见 ClassifyIndex::classify；规则没有 classify 时返回 -1
+    int classify(const PacketView &packet) const;
+    void dispatch(const PacketView &packet, ParseArena &arena); ///< 分类、解码并把结果交给回调
 
-    const json &parserRule;
-    const std::string &buffer;
+    RuleProgram ruleProgram;     ///< 构造时由json规则编译得到，逐包解析只执行它
+    ClassifyIndex classifyIndex; ///< 由规则中的 classify 与 messages 编译得到
+    std::vector<MessageLayout> layouts; ///< 有 classify 时与 messages 一一对应，否则只有一项
+    /// parser.<协议名>.filter/classify/decode，同一规则的所有实例共用；dropped 分别为未通过过滤、未能分类、长度不足
+    StageMetrics filterMetrics, classifyMetrics, decodeMetrics;
 };
 
+/// 为每个解析线程创建独立的解析器实例
+using ParserFactory = std::function<std::shared_ptr<ProtocolParser>()>;
+/// 由数据包计算流标识，同一流的数据包始终交给同一个解析线程，保证流内顺序
+using FlowKeyFunc = std::function<uint64_t(const PacketView &packet)>;
+
 class ProtocolManager
 {
 public:
+    ProtocolManager();
+    ~ProtocolManager();
     bool append(const std::string &ParserName, std::shared_ptr<ProtocolParser> newProtocolParser);
     bool select(const std::string &ParserName);
     void clear();
-    void clear(const std::string &ParserName);
-    void parse(const std::string &data);
+    void clear(const std::string &ParserName); ///< 等待正在使用该解析器的 parse 返回后才释放它
+    /// @brief 热替换：原子地用新解析器替换同名解析器（若正被选中则同时切换），正在解析的数据包在旧实例上完成后旧实例才被释放
+    /// 不能在 parse 回调内部调用
+    /// 换成同一个实例时什么都不做；实例已属于其他 ProtocolManager 时返回 false
+    bool swap(const std::string &ParserName, std::shared_ptr<ProtocolParser> newProtocolParser);
+    /// @brief 用新规则热替换：在调用线程上编译规则并构造 JsonProtocolParser，规则不合法时抛出异常且不做任何替换；
+    /// 解析线程池运行中时每个解析线程同样换成按新规则构造的实例
+    bool swapRules(const std::string &ParserName, const json &rule);
+    /// @brief 为每个解析线程换上 factory 创建的新解析器，语义同 swap
+    bool swapWorkers(ParserFactory factory);
+    /// 未启动解析线程池时在调用线程上同步解析；启动后按流标识分发到解析线程后立即返回
+    void parse(const PacketView &packet);
+    /// 同 parse，同步解析时整批交给解析器的 parseBatch
+    void parseBatch(const PacketView *packets, size_t count);
+    /// 为已有与之后加入（append/swap/startWorkers/swapWorkers）的所有解析器注册结果回调，可与解析并发（列表写时复制），
+    /// 但不能在结果回调内部调用；解析器上只注册一个转发回调，由它依次调用这里注册的回调，解析器不应在 ProtocolManager 析构后继续使用
+    void addResultCallback(ResultCallback callback);
+    /// @brief 把 TCP 字节流接入本管理器：按 rule 中的 framing（见 FrameRule）为每条连接分帧后逐帧 parse，
+    /// 连接关闭时释放该连接的分帧状态。rule 不合法时抛出 std::runtime_error；socket 应先于本管理器关闭
+    /// @param eventLoop 为空时 socket 用独立线程接收，否则注册到事件循环上
+    /// @return 同 TcpSocket::recv
+    int attachStream(TcpSocket &socket, const json &rule, EventLoop *eventLoop = nullptr);
+
+    /// @brief 启动并行解析：每个解析线程持有 factory 创建的解析器与一个 MPSC 队列
+    /// @param worker_count 解析线程数
+    /// @param flow_key 流标识函数，缺省按来源地址与 streamId
+    /// @param queue_slots 每个线程队列的槽位数
+    /// @param full_policy 队列满时丢弃还是让接收线程等待
+    /// @param slot_size 槽位内联数据区大小；更大的包（TCP 分帧、抓包回放）走槽位的堆缓冲区，最大 max_packet_size
+    /// @param max_packet_size 可交给解析线程的最大包长，缺省与分帧的最大帧长一致，超过的包计入 workerStats().oversized
+    bool startWorkers(size_t worker_count, ParserFactory factory, FlowKeyFunc flow_key = sourceFlowKey,
+                      size_t queue_slots = 4096, RingFullPolicy full_policy = RingFullPolicy::RF_Block,
+                      size_t slot_size = 4096, size_t max_packet_size = 65536);
+    void stopWorkers();                        ///< 处理完已排队的数据包后停止解析线程，回到同步解析
+    std::vector<PacketRingStats> workerStats() const;
+    uint64_t workerErrors() const { return parseErrors; }
+    /// @brief 设置解析阶段指标的名称前缀，缺省为 protocol（即 protocol.parse.*）；多个 ProtocolManager 并存时用于区分
+    void setMetricsName(const std::string &name);
+    /// @brief 开启/关闭逐包时延追踪，以数据包的 recvTime（开启 SO_TIMESTAMPNS 时为内核时间戳）为起点记录：
+    ///   <名称>.trace.recv_to_parse_ns    接收到开始解析，含接收回调与解析线程队列中的等待
+    ///   <名称>.trace.recv_to_result_ns   接收到结果回调开始，即再加上过滤、分类与解码
+    ///   <名称>.trace.result_callback_ns  结果回调本身的耗时
+    /// recvTime 为空的数据包不记录；回放抓包时 recvTime 为抓包时间，不应开启
+    void setLatencyTrace(bool enable) { traceEnabled.store(enable, std::memory_order_relaxed); }
+
+    static uint64_t sourceFlowKey(const PacketView &packet);       ///< 按来源 ip、端口与 streamId
+    static FlowKeyFunc fieldFlowKey(const FieldDescriptor &field); ///< 按包内字段，见 RuleProgram::flowKey
 
 private:
+    struct ParseWorker
+    {
+        std::shared_ptr<ProtocolParser> parser;  ///< 本线程独占的解析器
+        std::atomic<ProtocolParser *> current{}; ///< 解析线程读取的实例，热替换时原子切换
+        std::unique_ptr<MpscPacketRing> ring;
+        std::unique_ptr<RingWorker<MpscPacketRing>> worker;
+    };
+
+    /// @brief 解析线程池，整体构造完成后才发布，停止时整体摘下
+    struct WorkerSet
+    {
+        std::vector<std::unique_ptr<ParseWorker>> workers;
+        FlowKeyFunc flowKey;
+    };
+
+    /// @brief 逐包时延追踪的直方图
+    struct LatencyTrace
+    {
+        LatencyHistogram *recvToParse = nullptr;
+        LatencyHistogram *recvToResult = nullptr;
+        LatencyHistogram *resultCallback = nullptr;
+    };
+
+    /// 给新解析器注册转发回调，每个实例只注册一次；已注册到本管理器时直接返回 true，已注册到其他管理器时返回 false
+    bool attachCallbacks(ProtocolParser &parser) const;
+    void deliver(const ParseResult &result) const;      ///< 转发回调：依次调用 resultCallbacks，开启追踪时计时
+    void traceParse(const PacketView &packet, PacketView::Clock::time_point now) const;
+    void enqueue(WorkerSet &workers, const PacketView &packet); ///< 按流标识交给一个解析线程
+
+    using ResultCallbackList = std::vector<ResultCallback>;
+
     std::map<std::string, std::shared_ptr<ProtocolParser>> protocolParserPool;
-    ProtocolParser *curProtocolParser = nullptr;
+    std::shared_ptr<const ResultCallbackList> callbackList = std::make_shared<ResultCallbackList>(); ///< 当前回调列表的所有者，只在 swapMutex 下替换
+    std::atomic<const ResultCallbackList *> resultCallbacks{callbackList.get()}; ///< deliver 读取的列表，被替换的列表在 parserEpoch 宽限期后释放
+    std::atomic<bool> hasCallbacks{false};
+    std::atomic<ProtocolParser *> curProtocolParser{nullptr};
+    mutable std::mutex swapMutex; ///< 串行化解析器池、解析线程池与回调列表的修改，parse 不取它
+    EpochReclaimer parserEpoch;   ///< parse 期间持有读区，被替换的解析器、回调列表与停止的线程池在宽限期后才释放
+    std::unique_ptr<WorkerSet> workerSet;            ///< 解析线程池的所有者，只在 swapMutex 下替换
+    std::atomic<WorkerSet *> activeWorkers{nullptr}; ///< parse 读取的线程池，未启动时为空
+    std::atomic<uint64_t> parseErrors{0}; ///< 解析线程中抛出的异常数
+    /// <名称>.parse：packets/bytes 为交给解析器的数据包，dropped 为解析线程队列满丢弃，errors 为解析异常，
+    /// latency 为解析器处理一个数据包（同步批量解析时为一批）的耗时
+    StageMetrics parseMetrics;
+    LatencyTrace trace;
+    std::atomic<bool> traceEnabled{false};
 };
+#endif
@@ -0,0 +1,273 @@
+// 规则代码生成工具：RuleCodegen <规则.json> <输出.hpp> <类名>
+// 把 JsonProtocolParser 使用的协议规则生成为静态解码器头文件，字段布局全部是编译期常量，
+// 由 protocol_decoder() 在构建时调用，见 src/parser/CMakeLists.txt
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "RuleProgram.hpp"
+#include "ClassifyIndex.hpp"
+
+namespace
+{
+    std::string hex(uint64_t value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "0x%" PRIx64 "ull", value);
+        return buffer;
+    }
+
+    // C++ 字符串字面量，非可打印字符用三位八进制转义，避免十六进制转义吞掉后续字符
+    std::string literal(const std::string &text)
+    {
+        std::string out = "\"";
+        for (unsigned char t_ch : text)
+        {
+            if (t_ch == '"' || t_ch == '\\')
+            {
+                out.push_back('\\');
+                out.push_back(static_cast<char>(t_ch));
+            }
+            else if (t_ch < 0x20 || t_ch >= 0x7F)
+            {
+                char t_escape[8];
+                std::snprintf(t_escape, sizeof(t_escape), "\\%03o", t_ch);
+                out += t_escape;
+            }
+            else
+                out.push_back(static_cast<char>(t_ch));
+        }
+        return out + "\"";
+    }
+
+    const char *typeName(FieldType type)
+    {
+        switch (type)
+        {
+        case FieldType::FT_Int:
+            return "FieldType::FT_Int";
+        case FieldType::FT_UInt:
+            return "FieldType::FT_UInt";
+        case FieldType::FT_Float:
+            return "FieldType::FT_Float";
+        case FieldType::FT_Bits:
+            return "FieldType::FT_Bits";
+        default:
+            return "FieldType::FT_Bytes";
+        }
+    }
+
+    // 按 FieldDescriptor 成员声明顺序的指定初始化
+    std::string descriptor(const FieldDescriptor &field)
+    {
+        std::ostringstream out;
+        out << "{.offset = " << field.offset
+            << ", .length = " << field.length
+            << ", .type = " << typeName(field.type)
+            << ", .endian = " << (field.endian == Endian::ED_Big ? "Endian::ED_Big" : "Endian::ED_Little")
+            << ", .value = " << hex(field.value)
+            << ", .shift = " << int(field.shift)
+            << ", .mask = " << hex(field.mask)
+            << ", .op = " << (field.op == CompareOp::CO_In ? "CompareOp::CO_In" : "CompareOp::CO_Range")
+            << ", .invert = " << (field.invert ? "true" : "false")
+            << ", .lower = " << hex(field.lower)
+            << ", .upper = " << hex(field.upper) << "}";
+        return out.str();
+    }
+
+    struct MessageLayout
+    {
+        int index = -1; ///< 与 JsonProtocolParser 一致，没有 classify 时为 -1
+        std::vector<std::string> fieldNames;
+        std::vector<FieldDescriptor> fields;
+        size_t minLength = 0;
+    };
+
+    MessageLayout compileLayout(int index, const nlohmann::json &fields)
+    {
+        MessageLayout layout;
+        layout.index = index;
+        for (const auto &t_item : fields)
+        {
+            layout.fieldNames.push_back(t_item.at("name").get<std::string>());
+            layout.fields.push_back(RuleProgram::compileField(t_item));
+            layout.minLength = std::max<size_t>(layout.minLength, size_t(layout.fields.back().offset) + layout.fields.back().length);
+        }
+        return layout;
+    }
+
+    std::string generate(const nlohmann::json &rule, const std::string &rule_file, const std::string &class_name)
+    {
+        RuleProgram program(rule);
+        ClassifyIndex index(rule);
+        std::vector<MessageLayout> layouts;
+        if (index.empty())
+            layouts.push_back(compileLayout(-1, rule.value("fields", nlohmann::json::array())));
+        else
+        {
+            for (const auto &t_item : rule.at("messages"))
+                layouts.push_back(compileLayout(static_cast<int>(layouts.size()), t_item.value("fields", nlohmann::json::array())));
+        }
+        size_t maxFields = 0;
+        for (const auto &t_layout : layouts)
+            maxFields = std::max(maxFields, t_layout.fields.size());
+
+        auto ruleName = class_name + "Rule";
+        std::ostringstream out;
+        out << "// 由 RuleCodegen 根据 " << rule_file << " 生成，请勿手工修改\n"
+            << "#ifndef _" << class_name << "_hpp_\n"
+            << "#define _" << class_name << "_hpp_\n"
+            << "#include \"StaticDecoder.hpp\"\n\n"
+            << "/// @brief 协议 " << program.name() << " 的编译期规则\n"
+            << "struct " << ruleName << "\n{\n"
+            << "    static constexpr std::string_view protocol = " << literal(program.name()) << ";\n"
+            << "    static constexpr bool hasClassify = " << (index.empty() ? "false" : "true") << ";\n"
+            << "    static constexpr size_t maxFields = " << maxFields << ";\n\n";
+
+        // 字段描述符
+        std::vector<FieldDescriptor> filters;
+        for (const auto &t_field : program.filters())
+        {
+            if (t_field.enable)
+                filters.push_back(t_field);
+        }
+        for (size_t i = 0; i < filters.size(); i++)
+            out << "    static constexpr FieldDescriptor filter" << i << " = " << descriptor(filters[i]) << ";\n";
+        for (size_t i = 0; i < index.fields().size(); i++)
+            out << "    static constexpr FieldDescriptor classify" << i << " = " << descriptor(index.fields()[i]) << ";\n";
+        for (size_t i = 0; i < layouts.size(); i++)
+        {
+            for (size_t j = 0; j < layouts[i].fields.size(); j++)
+                out << "    static constexpr FieldDescriptor message" << i << "_field" << j << " = " << descriptor(layouts[i].fields[j]) << ";\n";
+        }
+
+        // 过滤：一次边界检查后依次比较
+        out << "\n    static bool filter(const uint8_t *data, size_t length)\n    {\n";
+        if (filters.empty())
+            out << "        (void)data;\n        (void)length;\n        return true;\n";
+        else
+        {
+            out << "        if (length < " << program.requiredLength() << ")\n            return false;\n        return ";
+            for (size_t i = 0; i < filters.size(); i++)
+            {
+                const auto &t_field = filters[i];
+                auto t_name = "filter" + std::to_string(i);
+                if (i > 0)
+                    out << " &&\n               ";
+                if (t_field.type == FieldType::FT_Bytes)
+                {
+                    const auto &t_pattern = program.bytePattern(t_field);
+                    out << "StaticField::equalBytes<" << t_name << ">(data, " << literal(t_pattern) << ")";
+                }
+                else if (t_field.op == CompareOp::CO_In)
+                {
+                    out << "StaticField::inSet<" << t_name;
+                    for (auto t_key : program.setOf(t_field))
+                        out << ", " << hex(t_key);
+                    out << ">(data)";
+                }
+                else
+                    out << "StaticField::inRange<" << t_name << ">(data)";
+            }
+            out << ";\n";
+        }
+        out << "    }\n";
+
+        // 分类：拼接判别字段后 switch，由编译器选择跳转表或比较树
+        out << "\n    static int classify(const uint8_t *data, size_t length)\n    {\n";
+        if (index.empty())
+            out << "        (void)data;\n        (void)length;\n        return -1;\n";
+        else
+        {
+            out << "        if (length < " << index.requiredLength() << ")\n            return -1;\n"
+                << "        uint64_t key = 0;\n";
+            for (size_t i = 0; i < index.fields().size(); i++)
+            {
+                auto t_name = "classify" + std::to_string(i);
+                auto t_value = "((RuleProgram::loadRaw(" + t_name + ", data) >> " + t_name + ".shift) & " + t_name + ".mask)";
+                if (index.fieldWidths()[i] == 64)
+                    out << "        key = " << t_value << ";\n";
+                else
+                    out << "        key = (key << " << int(index.fieldWidths()[i]) << ") | " << t_value << ";\n";
+            }
+            out << "        switch (key)\n        {\n";
+            for (const auto &t_message : index.messages())
+            {
+                if (t_message.hasKey)
+                    out << "        case " << hex(t_message.key) << ":\n            return " << t_message.index << ";\n";
+            }
+            out << "        default:\n            return " << index.defaultMessage() << ";\n        }\n";
+        }
+        out << "    }\n";
+
+        out << "\n    static std::string_view messageName(int index)\n    {\n        switch (index)\n        {\n";
+        for (const auto &t_message : index.messages())
+            out << "        case " << t_message.index << ":\n            return " << literal(t_message.name) << ";\n";
+        out << "        default:\n            return {};\n        }\n    }\n";
+
+        // 解码：每种消息一段直线代码
+        out << "\n    static bool decode(int index, const uint8_t *data, size_t length, FieldValue *fields, size_t &count)\n    {\n"
+            << "        (void)data;\n        (void)fields;\n"
+            << "        switch (index)\n        {\n";
+        for (size_t i = 0; i < layouts.size(); i++)
+        {
+            const auto &t_layout = layouts[i];
+            out << "        case " << t_layout.index << ":\n";
+            if (t_layout.minLength > 0)
+                out << "            if (length < " << t_layout.minLength << ")\n                return false;\n";
+            for (size_t j = 0; j < t_layout.fields.size(); j++)
+                out << "            StaticField::decode<message" << i << "_field" << j << ">(data, " << literal(t_layout.fieldNames[j])
+                    << ", fields[" << j << "]);\n";
+            out << "            count = " << t_layout.fields.size() << ";\n            return true;\n";
+        }
+        out << "        default:\n            (void)length;\n            return false;\n        }\n    }\n};\n\n";
+
+        out << "using " << class_name << " = StaticProtocolParser<" << ruleName << ">;\n\n"
+            << "/// @brief 注册到 ProtocolManager，name 缺省为协议名称\n"
+            << "inline bool register" << class_name << "(ProtocolManager &manager, const std::string &name = std::string(" << ruleName << "::protocol))\n"
+            << "{\n    return manager.append(name, std::make_shared<" << class_name << ">());\n}\n"
+            << "#endif\n";
+        return out.str();
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "用法: " << argv[0] << " <规则.json> <输出.hpp> <类名>" << std::endl;
+        return 1;
+    }
+    std::ifstream input(argv[1]);
+    if (!input.is_open())
+    {
+        std::cerr << "无法打开规则文件: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::string header;
+    try
+    {
+        auto rule = nlohmann::json::parse(input);
+        auto ruleFile = std::string(argv[1]);
+        header = generate(rule, ruleFile.substr(ruleFile.find_last_of('/') + 1), argv[3]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "规则文件 " << argv[1] << " 不合法: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream output(argv[2], std::ios::trunc);
+    if (!output.is_open())
+    {
+        std::cerr << "无法写入输出文件: " << argv[2] << std::endl;
+        return 1;
+    }
+    output << header;
+    return output.good() ? 0 : 1;
+}
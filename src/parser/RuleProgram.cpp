@@ -0,0 +1,441 @@
+#include "RuleProgram.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    /// 类型名称对应的字段类型，以及 int8/uint16 这类名称隐含的长度（0 表示由 length 指定）
+    struct TypeSpec
+    {
+        FieldType type;
+        int64_t length;
+    };
+
+    TypeSpec toFieldType(const std::string &type_name)
+    {
+        static const std::pair<const char *, TypeSpec> typeTable[] = {
+            {"int", {FieldType::FT_Int, 0}},
+            {"uint", {FieldType::FT_UInt, 0}},
+            {"int8", {FieldType::FT_Int, 1}},
+            {"int16", {FieldType::FT_Int, 2}},
+            {"int32", {FieldType::FT_Int, 4}},
+            {"int64", {FieldType::FT_Int, 8}},
+            {"uint8", {FieldType::FT_UInt, 1}},
+            {"uint16", {FieldType::FT_UInt, 2}},
+            {"uint32", {FieldType::FT_UInt, 4}},
+            {"uint64", {FieldType::FT_UInt, 8}},
+            {"float", {FieldType::FT_Float, 4}},
+            {"double", {FieldType::FT_Float, 8}},
+            {"bits", {FieldType::FT_Bits, 0}},
+            {"bytes", {FieldType::FT_Bytes, 0}},
+        };
+        for (const auto &t_entry : typeTable)
+        {
+            if (type_name == t_entry.first)
+                return t_entry.second;
+        }
+        throw std::runtime_error("Unsupported filter type: " + type_name);
+    }
+
+    Endian toEndian(const std::string &endian_name)
+    {
+        if (endian_name == "big")
+            return Endian::ED_Big;
+        if (endian_name == "little")
+            return Endian::ED_Little;
+        throw std::runtime_error("Unsupported endian: " + endian_name);
+    }
+
+    std::string hexToBytes(const std::string &hex)
+    {
+        std::string digits;
+        for (char t_ch : hex)
+        {
+            if (std::isxdigit(static_cast<unsigned char>(t_ch)))
+                digits.push_back(t_ch);
+            else if (t_ch != ' ' && t_ch != ':')
+                throw std::runtime_error("Invalid hex byte string: " + hex);
+        }
+        if (digits.size() % 2)
+            throw std::runtime_error("Hex byte string must have an even number of digits: " + hex);
+        std::string bytes;
+        for (size_t i = 0; i < digits.size(); i += 2)
+            bytes.push_back(static_cast<char>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+        return bytes;
+    }
+
+    // 规则中的比较值转换为字段的原始表示（value）
+    uint64_t toRaw(const FieldDescriptor &field, const nlohmann::json &value)
+    {
+        switch (field.type)
+        {
+        case FieldType::FT_Int:
+            return static_cast<uint64_t>(value.get<int64_t>());
+        case FieldType::FT_Float:
+        {
+            uint64_t bits;
+            if (field.length == 4)
+            {
+                float t_val = value.get<float>();
+                uint32_t t_bits;
+                std::memcpy(&t_bits, &t_val, sizeof(t_bits));
+                bits = t_bits;
+            }
+            else
+            {
+                double t_val = value.get<double>();
+                std::memcpy(&bits, &t_val, sizeof(bits));
+            }
+            return bits;
+        }
+        default:
+            return RuleProgram::toUInt(value);
+        }
+    }
+
+    // 规则中的比较值转换为有序键，与 RuleProgram::extract 的结果可直接比较
+    uint64_t toKey(const FieldDescriptor &field, const nlohmann::json &value)
+    {
+        switch (field.type)
+        {
+        case FieldType::FT_Int:
+            return static_cast<uint64_t>(value.get<int64_t>()) ^ RuleProgram::signBit;
+        case FieldType::FT_Float:
+        {
+            // 4 字节字段运行时由 float 扩展为 double，比较值同样先取最接近的 float，否则 0.1 之类的值永远不相等
+            double t_val = field.length == 4 ? static_cast<double>(value.get<float>()) : value.get<double>();
+            uint64_t bits;
+            std::memcpy(&bits, &t_val, sizeof(bits));
+            return RuleProgram::floatKey(bits);
+        }
+        default:
+            return RuleProgram::toUInt(value);
+        }
+    }
+
+    ///////////////////////////////批量比较内核////////////////////////////////
+    // keys 中是一组数据包（最多 64 个）同一字段的有序键，返回满足比较的位图（未计 invert）
+
+    constexpr size_t batchLanes = 64;
+    constexpr size_t smallSetSize = 16; ///< 不超过该大小的集合在向量内核中逐个比较，更大的集合走二分查找
+
+    using CompareKernel = uint64_t (*)(const FieldDescriptor &field, const uint64_t *set_keys, const uint64_t *keys);
+
+    uint64_t compareScalar(const FieldDescriptor &field, const uint64_t *set_keys, const uint64_t *keys)
+    {
+        uint64_t hits = 0;
+        if (field.op == CompareOp::CO_Range)
+        {
+            for (size_t i = 0; i < batchLanes; i++)
+                hits |= uint64_t(keys[i] >= field.lower && keys[i] <= field.upper) << i;
+        }
+        else
+        {
+            auto first = set_keys + field.setBegin;
+            for (size_t i = 0; i < batchLanes; i++)
+                hits |= uint64_t(std::binary_search(first, first + field.setCount, keys[i])) << i;
+        }
+        return hits;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // 有序键是无符号的，翻转符号位后用有符号比较指令
+    __attribute__((target("avx2"))) uint64_t compareAvx2(const FieldDescriptor &field, const uint64_t *set_keys, const uint64_t *keys)
+    {
+        if (field.op == CompareOp::CO_In && field.setCount > smallSetSize)
+            return compareScalar(field, set_keys, keys);
+        const __m256i sign = _mm256_set1_epi64x(static_cast<int64_t>(RuleProgram::signBit));
+        uint64_t hits = 0;
+        if (field.op == CompareOp::CO_Range)
+        {
+            const __m256i lower = _mm256_set1_epi64x(static_cast<int64_t>(field.lower ^ RuleProgram::signBit));
+            const __m256i upper = _mm256_set1_epi64x(static_cast<int64_t>(field.upper ^ RuleProgram::signBit));
+            for (size_t i = 0; i < batchLanes; i += 4)
+            {
+                auto t_val = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i *>(keys + i)), sign);
+                auto t_miss = _mm256_or_si256(_mm256_cmpgt_epi64(lower, t_val), _mm256_cmpgt_epi64(t_val, upper));
+                hits |= uint64_t(~_mm256_movemask_pd(_mm256_castsi256_pd(t_miss)) & 0xF) << i;
+            }
+            return hits;
+        }
+        for (size_t i = 0; i < batchLanes; i += 4)
+        {
+            auto t_val = _mm256_load_si256(reinterpret_cast<const __m256i *>(keys + i));
+            auto t_hit = _mm256_setzero_si256();
+            for (uint32_t j = 0; j < field.setCount; j++)
+                t_hit = _mm256_or_si256(t_hit, _mm256_cmpeq_epi64(t_val, _mm256_set1_epi64x(static_cast<int64_t>(set_keys[field.setBegin + j]))));
+            hits |= uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(t_hit))) << i;
+        }
+        return hits;
+    }
+
+    __attribute__((target("sse4.2"))) uint64_t compareSse42(const FieldDescriptor &field, const uint64_t *set_keys, const uint64_t *keys)
+    {
+        if (field.op == CompareOp::CO_In && field.setCount > smallSetSize)
+            return compareScalar(field, set_keys, keys);
+        const __m128i sign = _mm_set1_epi64x(static_cast<int64_t>(RuleProgram::signBit));
+        uint64_t hits = 0;
+        if (field.op == CompareOp::CO_Range)
+        {
+            const __m128i lower = _mm_set1_epi64x(static_cast<int64_t>(field.lower ^ RuleProgram::signBit));
+            const __m128i upper = _mm_set1_epi64x(static_cast<int64_t>(field.upper ^ RuleProgram::signBit));
+            for (size_t i = 0; i < batchLanes; i += 2)
+            {
+                auto t_val = _mm_xor_si128(_mm_load_si128(reinterpret_cast<const __m128i *>(keys + i)), sign);
+                auto t_miss = _mm_or_si128(_mm_cmpgt_epi64(lower, t_val), _mm_cmpgt_epi64(t_val, upper));
+                hits |= uint64_t(~_mm_movemask_pd(_mm_castsi128_pd(t_miss)) & 0x3) << i;
+            }
+            return hits;
+        }
+        for (size_t i = 0; i < batchLanes; i += 2)
+        {
+            auto t_val = _mm_load_si128(reinterpret_cast<const __m128i *>(keys + i));
+            auto t_hit = _mm_setzero_si128();
+            for (uint32_t j = 0; j < field.setCount; j++)
+                t_hit = _mm_or_si128(t_hit, _mm_cmpeq_epi64(t_val, _mm_set1_epi64x(static_cast<int64_t>(set_keys[field.setBegin + j]))));
+            hits |= uint64_t(_mm_movemask_pd(_mm_castsi128_pd(t_hit))) << i;
+        }
+        return hits;
+    }
+#endif
+
+    CompareKernel selectKernel()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return compareAvx2;
+        if (__builtin_cpu_supports("sse4.2"))
+            return compareSse42;
+#endif
+        return compareScalar;
+    }
+
+    const CompareKernel compareKeys = selectKernel(); ///< 进程启动时按 CPU 能力选定
+}
+
+uint64_t RuleProgram::toUInt(const nlohmann::json &value)
+{
+    if (value.is_string())
+        return std::stoull(value.get<std::string>(), nullptr, 0);
+    return value.get<uint64_t>();
+}
+
+FieldDescriptor RuleProgram::compileField(const nlohmann::json &item, size_t implied_length)
+{
+    FieldDescriptor field;
+    auto spec = toFieldType(item.value("type", "int"));
+    field.type = spec.type;
+    field.endian = toEndian(item.value("endian", "big"));
+
+    auto offset = item.at("offset").get<int64_t>();
+    if (offset < 0 || offset > UINT32_MAX)
+        throw std::runtime_error("Field offset out of range: " + std::to_string(offset));
+    field.offset = static_cast<uint32_t>(offset);
+
+    int64_t length = field.type == FieldType::FT_Bytes ? int64_t(implied_length) : spec.length;
+    if (item.contains("length"))
+    {
+        auto declared = item.at("length").get<int64_t>();
+        if (length != 0 && declared != length)
+            throw std::runtime_error("Field length does not match its type: " + std::to_string(declared));
+        length = declared;
+    }
+    if (field.type == FieldType::FT_Bytes)
+    {
+        if (length < 1 || length > UINT16_MAX)
+            throw std::runtime_error("Field byte string length out of range: " + std::to_string(length));
+    }
+    else if (length < 1 || length > 8)
+        throw std::runtime_error("Field length must be 1~8 bytes: " + std::to_string(length));
+    if (field.type == FieldType::FT_Float && length != 4 && length != 8)
+        throw std::runtime_error("Float field length must be 4 or 8 bytes: " + std::to_string(length));
+    field.length = static_cast<uint16_t>(length);
+
+    if (field.type == FieldType::FT_Bits)
+    {
+        auto bitOffset = item.value("bit-offset", int64_t(0));
+        auto bitLength = item.at("bit-length").get<int64_t>();
+        if (bitOffset < 0 || bitLength < 1 || bitOffset + bitLength > length * 8)
+            throw std::runtime_error("Bit field exceeds its " + std::to_string(length) + " byte container");
+        field.shift = static_cast<uint8_t>(bitOffset);
+        field.mask = bitLength == 64 ? ~uint64_t(0) : (uint64_t(1) << bitLength) - 1;
+    }
+    if (item.contains("mask"))
+    {
+        if (field.type == FieldType::FT_Float || field.type == FieldType::FT_Bytes)
+            throw std::runtime_error("Field mask only applies to integer fields");
+        field.mask &= toUInt(item.at("mask"));
+    }
+    return field;
+}
+
+RuleProgram::RuleProgram(const nlohmann::json &rule)
+{
+    if (!rule.is_object())
+        throw std::runtime_error("Protocol rule must be a json object");
+
+    auto info = rule.find("protocol-info");
+    if (info != rule.end() && info->is_object())
+    {
+        this->protocolName = info->value("name", "");
+        this->protocolDescription = info->value("description", "");
+        this->protocolVersion = info->value("version", "");
+    }
+
+    auto flowKey = rule.find("flow-key");
+    if (flowKey != rule.end())
+    {
+        auto offset = flowKey->at("offset").get<int64_t>();
+        auto length = flowKey->at("length").get<int64_t>();
+        if (offset < 0 || offset > UINT32_MAX || length < 1 || length > 8)
+            throw std::runtime_error("Invalid flow-key field");
+        this->flowKeyField.offset = static_cast<uint32_t>(offset);
+        this->flowKeyField.length = static_cast<uint16_t>(length);
+        this->flowKeyField.type = FieldType::FT_UInt;
+        this->flowKeyField.endian = toEndian(flowKey->value("endian", "big"));
+    }
+
+    auto filter = rule.find("filter");
+    if (filter == rule.end())
+        return;
+    if (!filter->is_array())
+        throw std::runtime_error("Protocol rule \"filter\" must be an array");
+
+    this->filterFields.reserve(filter->size());
+    for (const auto &t_item : *filter)
+    {
+        std::string t_pattern;
+        if (t_item.value("type", "int") == "bytes")
+            t_pattern = hexToBytes(t_item.at("value").get<std::string>());
+        auto t_field = compileField(t_item, t_pattern.size());
+        t_field.enable = t_item.value("enable", true);
+
+        // 所有比较都编译成区间或集合，比较时不再区分类型
+        auto t_op = t_item.value("op", "eq");
+        if (t_field.type == FieldType::FT_Bytes)
+        {
+            if (t_op != "eq" && t_op != "ne")
+                throw std::runtime_error("Byte string filter only supports eq/ne: " + t_op);
+            t_field.invert = t_op == "ne";
+            t_field.setBegin = static_cast<uint32_t>(this->bytePatterns.size());
+            this->bytePatterns.push_back(std::move(t_pattern));
+        }
+        else if (t_op == "eq" || t_op == "ne")
+        {
+            t_field.value = toRaw(t_field, t_item.at("value"));
+            t_field.lower = t_field.upper = toKey(t_field, t_item.at("value"));
+            t_field.invert = t_op == "ne";
+        }
+        else if (t_op == "lt" || t_op == "le" || t_op == "gt" || t_op == "ge")
+        {
+            auto t_key = toKey(t_field, t_item.at("value"));
+            t_field.lower = 0;
+            t_field.upper = UINT64_MAX;
+            // x < v 编译为 !(x >= v)，x > v 编译为 !(x <= v)
+            if (t_op == "lt" || t_op == "ge")
+                t_field.lower = t_key;
+            else
+                t_field.upper = t_key;
+            t_field.invert = t_op == "lt" || t_op == "gt";
+        }
+        else if (t_op == "range")
+        {
+            t_field.lower = toKey(t_field, t_item.at("min"));
+            t_field.upper = toKey(t_field, t_item.at("max"));
+        }
+        else if (t_op == "in" || t_op == "not-in")
+        {
+            t_field.op = CompareOp::CO_In;
+            t_field.invert = t_op == "not-in";
+            std::vector<uint64_t> t_keys;
+            for (const auto &t_value : t_item.at("values"))
+                t_keys.push_back(toKey(t_field, t_value));
+            std::sort(t_keys.begin(), t_keys.end());
+            t_keys.erase(std::unique(t_keys.begin(), t_keys.end()), t_keys.end());
+            t_field.setBegin = static_cast<uint32_t>(this->setKeys.size());
+            t_field.setCount = static_cast<uint32_t>(t_keys.size());
+            this->setKeys.insert(this->setKeys.end(), t_keys.begin(), t_keys.end());
+        }
+        else
+            throw std::runtime_error("Unsupported filter op: " + t_op);
+
+        if (t_field.enable)
+        {
+            this->minLength = std::max<size_t>(this->minLength, size_t(t_field.offset) + t_field.length);
+            this->activeFields.push_back(t_field);
+        }
+        this->filterFields.push_back(t_field);
+    }
+}
+
+bool RuleProgram::test(const FieldDescriptor &field, const uint8_t *data) const
+{
+    if (field.type == FieldType::FT_Bytes)
+    {
+        const auto &pattern = this->bytePatterns[field.setBegin];
+        return (std::memcmp(data + field.offset, pattern.data(), pattern.size()) == 0) != field.invert;
+    }
+    auto key = extract(field, data);
+    bool hit;
+    if (field.op == CompareOp::CO_Range)
+        hit = key >= field.lower && key <= field.upper;
+    else
+    {
+        auto first = this->setKeys.begin() + field.setBegin;
+        hit = std::binary_search(first, first + field.setCount, key);
+    }
+    return hit != field.invert;
+}
+
+bool RuleProgram::match(const uint8_t *data, size_t length) const
+{
+    if (length < this->minLength)
+        return false;
+    for (const auto &t_field : this->activeFields)
+    {
+        if (!this->test(t_field, data))
+            return false;
+    }
+    return true;
+}
+
+void RuleProgram::matchBatch(const PacketView *packets, size_t count, uint8_t *matched) const
+{
+    alignas(32) uint64_t keys[batchLanes];
+    for (size_t base = 0; base < count; base += batchLanes)
+    {
+        auto lanes = std::min(batchLanes, count - base);
+        const PacketView *group = packets + base;
+        // alive 的第 i 位表示该组第 i 个包目前仍满足所有已执行的条件
+        uint64_t alive = 0;
+        for (size_t i = 0; i < lanes; i++)
+            alive |= uint64_t(group[i].length >= this->minLength) << i;
+
+        for (const auto &t_field : this->activeFields)
+        {
+            if (!alive)
+                break;
+            if (t_field.type == FieldType::FT_Bytes)
+            {
+                for (size_t i = 0; i < lanes; i++)
+                {
+                    if ((alive >> i) & 1)
+                        alive &= ~(uint64_t(!this->test(t_field, group[i].data)) << i);
+                }
+                continue;
+            }
+            for (size_t i = 0; i < batchLanes; i++)
+                keys[i] = ((alive >> i) & 1) ? extract(t_field, group[i].data) : 0;
+            auto hits = compareKeys(t_field, this->setKeys.data(), keys);
+            alive &= t_field.invert ? ~hits : hits;
+        }
+
+        for (size_t i = 0; i < lanes; i++)
+            matched[base + i] = (alive >> i) & 1;
+    }
+}
@@ -0,0 +1,205 @@
+#ifndef _RuleProgram_hpp_
+#define _RuleProgram_hpp_
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "PacketView.hpp"
+
+/// @brief 字段值类型
+enum class FieldType : uint8_t
+{
+    FT_Int,   ///< 有符号整数
+    FT_UInt,  ///< 无符号整数
+    FT_Float, ///< IEEE 754 浮点，长度 4 或 8
+    FT_Bits,  ///< 位字段：按长度与字节序读出整数后右移 shift 位再取 mask，无符号
+    FT_Bytes, ///< 字节串，逐字节与规则中的十六进制串比较，只支持相等/不等
+};
+
+/// @brief 比较方式
+enum class CompareOp : uint8_t
+{
+    CO_Range, ///< 闭区间 [lower, upper]，eq/lt/le/gt/ge/range 都编译为区间
+    CO_In,    ///< 属于集合
+};
+
+/// @brief 字段字节序
+enum class Endian : uint8_t
+{
+    ED_Big,    ///< 大端（网络字节序，默认）
+    ED_Little, ///< 小端
+};
+
+/// @brief 编译后的字段描述符，由json规则中的一条filter生成
+struct FieldDescriptor
+{
+    uint32_t offset = 0;                ///< 字段在包内的字节偏移
+    uint16_t length = 0;                ///< 字段字节长度，1~8
+    FieldType type = FieldType::FT_Int; ///< 字段类型
+    Endian endian = Endian::ED_Big;     ///< 字段字节序
+    bool enable = true;                 ///< 是否启用
+    uint64_t value = 0;                 ///< 比较值，有符号类型按补码存放，浮点为 double 的位模式；仅 eq/ne 有意义
+    uint8_t shift = 0;                  ///< 取值前右移的位数（FT_Bits）
+    uint64_t mask = ~uint64_t(0);       ///< 右移后与上的掩码，在符号扩展之前生效
+    CompareOp op = CompareOp::CO_Range; ///< 比较方式
+    bool invert = false;                ///< 结果取反，用于 ne 与 not-in
+    uint64_t lower = 0;                 ///< CO_Range 下界，有序键
+    uint64_t upper = 0;                 ///< CO_Range 上界，有序键
+    uint32_t setBegin = 0;              ///< CO_In 集合在 setKeys 中的起点，FT_Bytes 为 bytePatterns 的下标
+    uint32_t setCount = 0;              ///< CO_In 的集合大小
+};
+
+/// @brief 规则程序，构造时把json规则编译成连续的字段描述符数组，逐包执行时不访问json也不分配内存
+/// filter 每项的字段：
+///   type    int/uint（长度由 length 指定）、int8~int64、uint8~uint64、float、double、bits、bytes
+///   offset/length/endian  字段位置、字节长度与字节序；bits 的 length 为容纳位字段的字节数
+///   bit-offset/bit-length bits 专用，从读出整数的最低位起算
+///   mask    整数字段取值后与上的掩码，可写成 "0x0F"
+///   op      eq（默认）/ne/lt/le/gt/ge 用 value；range 用 min 与 max（闭区间）；in/not-in 用 values 数组
+///   bytes 的 value 为十六进制串，只支持 eq/ne
+class RuleProgram
+{
+public:
+    RuleProgram() = default;
+    /// @brief 编译json规则，规则不合法时抛出 std::runtime_error
+    /// @param rule 协议规则，包含 protocol-info 与 filter
+    explicit RuleProgram(const nlohmann::json &rule);
+
+    /// @brief 编译单个字段的位置与类型（type/offset/length/endian/bit-offset/bit-length/mask），不含比较
+    /// @param implied_length bytes 类型未写 length 时使用的长度
+    static FieldDescriptor compileField(const nlohmann::json &item, size_t implied_length = 0);
+    /// @brief 规则中的无符号整数：数值或 "0x.." 形式的字符串
+    static uint64_t toUInt(const nlohmann::json &value);
+
+    /// @brief 执行过滤程序
+    /// @return 所有启用的过滤条件都满足时返回true，包长不足视为不满足
+    bool match(const uint8_t *data, size_t length) const;
+
+    /// @brief 批量执行过滤程序，与逐包 match 结果一致
+    /// 按过滤条件逐个遍历整批数据包：先把字段取成有序键，再用 AVX2/SSE4.2（运行期检测，缺失时回退到标量）
+    /// 一次比较多个数据包，整批都不满足时提前结束；没有逐包逐条件的分支
+    /// @param matched 输出，matched[i] 为 1 表示第 i 个包满足
+    void matchBatch(const PacketView *packets, size_t count, uint8_t *matched) const;
+
+    /// @brief 按描述符从包内读取字段值，有符号类型做符号扩展；调用方保证不越界
+    static inline uint64_t load(const FieldDescriptor &field, const uint8_t *data)
+    {
+        uint64_t val = loadRaw(field, data);
+        if (field.type == FieldType::FT_Int && field.length < 8)
+        {
+            auto shift = 64 - field.length * 8;
+            val = static_cast<uint64_t>(static_cast<int64_t>(val << shift) >> shift);
+        }
+        return val;
+    }
+
+    /// @brief 读取字段值：右移并取掩码，有符号类型做符号扩展，浮点统一返回 double 的位模式；调用方保证不越界
+    static inline uint64_t value(const FieldDescriptor &field, const uint8_t *data)
+    {
+        uint64_t val = (loadRaw(field, data) >> field.shift) & field.mask;
+        if (field.type == FieldType::FT_Int && field.length < 8)
+        {
+            auto shift = 64 - field.length * 8;
+            val = static_cast<uint64_t>(static_cast<int64_t>(val << shift) >> shift);
+        }
+        else if (field.type == FieldType::FT_Float && field.length == 4)
+        {
+            float t_val;
+            uint32_t t_bits = static_cast<uint32_t>(val);
+            std::memcpy(&t_val, &t_bits, sizeof(t_val));
+            double t_wide = t_val;
+            std::memcpy(&val, &t_wide, sizeof(val));
+        }
+        return val;
+    }
+
+    /// @brief 读取字段并转换成有序键：无符号数原样，有符号数翻转符号位，浮点按 IEEE 位模式映射，
+    /// 使所有类型的大小关系都等同于键的无符号大小关系，比较时不再区分类型
+    static inline uint64_t extract(const FieldDescriptor &field, const uint8_t *data)
+    {
+        uint64_t val = value(field, data);
+        switch (field.type)
+        {
+        case FieldType::FT_Int:
+            return val ^ signBit;
+        case FieldType::FT_Float:
+            return floatKey(val);
+        default:
+            return val;
+        }
+    }
+
+    /// @brief double 位模式到有序键
+    static constexpr uint64_t floatKey(uint64_t bits) { return (bits & signBit) ? ~bits : bits | signBit; }
+    static constexpr uint64_t signBit = uint64_t(1) << 63;
+
+    /// @brief 按长度与字节序读取无符号原始值；调用方保证不越界
+    static inline uint64_t loadRaw(const FieldDescriptor &field, const uint8_t *data)
+    {
+        const uint8_t *src = data + field.offset;
+        uint64_t val = 0;
+        switch (field.length)
+        {
+        case 1:
+            val = src[0];
+            break;
+        case 2:
+        {
+            uint16_t t_val;
+            std::memcpy(&t_val, src, sizeof(t_val));
+            val = field.endian == Endian::ED_Big ? __builtin_bswap16(t_val) : t_val;
+            break;
+        }
+        case 4:
+        {
+            uint32_t t_val;
+            std::memcpy(&t_val, src, sizeof(t_val));
+            val = field.endian == Endian::ED_Big ? __builtin_bswap32(t_val) : t_val;
+            break;
+        }
+        case 8:
+        {
+            uint64_t t_val;
+            std::memcpy(&t_val, src, sizeof(t_val));
+            val = field.endian == Endian::ED_Big ? __builtin_bswap64(t_val) : t_val;
+            break;
+        }
+        default:
+            for (uint16_t i = 0; i < field.length; i++)
+            {
+                auto t_shift = field.endian == Endian::ED_Big ? (field.length - 1 - i) * 8 : i * 8;
+                val |= static_cast<uint64_t>(src[i]) << t_shift;
+            }
+            break;
+        }
+        return val;
+    }
+
+    const std::string &name() const { return protocolName; }
+    const std::string &description() const { return protocolDescription; }
+    const std::string &version() const { return protocolVersion; }
+    const std::vector<FieldDescriptor> &filters() const { return filterFields; }
+    const std::string &bytePattern(const FieldDescriptor &field) const { return bytePatterns[field.setBegin]; } ///< FT_Bytes 的比较串
+    std::span<const uint64_t> setOf(const FieldDescriptor &field) const { return {setKeys.data() + field.setBegin, field.setCount}; } ///< CO_In 的有序键集合
+    size_t requiredLength() const { return minLength; } ///< 所有启用字段需要的最小包长
+    bool hasFlowKey() const { return flowKeyField.length > 0; }
+    const FieldDescriptor &flowKey() const { return flowKeyField; } ///< 规则 "flow-key" 定义的流标识字段
+
+private:
+    /// @brief 单个条件是否满足，不检查包长
+    bool test(const FieldDescriptor &field, const uint8_t *data) const;
+
+    std::string protocolName;
+    std::string protocolDescription;
+    std::string protocolVersion;
+    std::vector<FieldDescriptor> filterFields; ///< 过滤条件程序
+    std::vector<FieldDescriptor> activeFields; ///< 只含启用的条件，逐包执行的就是它
+    std::vector<uint64_t> setKeys;             ///< CO_In 集合的有序键，每个集合内升序
+    std::vector<std::string> bytePatterns;     ///< FT_Bytes 的比较串
+    size_t minLength = 0;                      ///< 所有启用字段需要的最小包长，逐包只做一次边界检查
+    FieldDescriptor flowKeyField;              ///< 流标识字段，length 为 0 表示未定义
+};
+#endif
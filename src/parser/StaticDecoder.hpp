@@ -0,0 +1,108 @@
+#ifndef _StaticDecoder_hpp_
+#define _StaticDecoder_hpp_
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "ProtocolParser.hpp"
+
+/// @brief 生成代码使用的字段操作，字段描述符作为模板参数传入，
+/// 偏移、长度、字节序、掩码与比较值都是编译期常量，读取与比较在编译期展开成固定的指令序列
+struct StaticField
+{
+    /// 区间比较，见 CompareOp::CO_Range
+    template <FieldDescriptor F>
+    static inline bool inRange(const uint8_t *data)
+    {
+        auto key = RuleProgram::extract(F, data);
+        return (key >= F.lower && key <= F.upper) != F.invert;
+    }
+
+    /// 集合比较，集合展开为常量比较序列，见 CompareOp::CO_In
+    template <FieldDescriptor F, uint64_t... Keys>
+    static inline bool inSet(const uint8_t *data)
+    {
+        auto key = RuleProgram::extract(F, data);
+        return ((key == Keys) || ...) != F.invert;
+    }
+
+    /// 字节串比较，pattern 长度为 F.length
+    template <FieldDescriptor F>
+    static inline bool equalBytes(const uint8_t *data, const char *pattern)
+    {
+        return (std::memcmp(data + F.offset, pattern, F.length) == 0) != F.invert;
+    }
+
+    /// 解码单个字段，与 JsonProtocolParser 的结果一致
+    template <FieldDescriptor F>
+    static inline void decode(const uint8_t *data, std::string_view name, FieldValue &out)
+    {
+        out.name = name;
+        out.type = F.type;
+        if constexpr (F.type == FieldType::FT_Bytes)
+        {
+            out.u = 0;
+            out.bytes = std::string_view(reinterpret_cast<const char *>(data) + F.offset, F.length);
+        }
+        else
+        {
+            out.u = RuleProgram::value(F, data);
+            out.bytes = {};
+        }
+    }
+};
+
+/// @brief 由 RuleCodegen 生成的规则类静态分派的解析器
+/// Rule 提供（均为静态成员）：
+///   protocol                                      协议名称
+///   hasClassify / maxFields                       是否有 classify，单个消息最多的字段数
+///   filter(data, length)                          过滤条件
+///   classify(data, length)                        消息类型下标，同 ClassifyIndex::classify
+///   messageName(index)                            消息类型名称
+///   decode(index, data, length, fields, count)    解码消息字段，包长不足返回 false
+/// 逐包不经过规则解释与虚函数分派，结果与按同一规则构造的 JsonProtocolParser 相同
+template <typename Rule>
+class StaticProtocolParser final : public ProtocolParser
+{
+public:
+    void parse(const PacketView &packet) override
+    {
+        if (Rule::filter(packet.data, packet.length))
+            this->dispatch(packet);
+    }
+
+    void parseBatch(const PacketView *packets, size_t count) override
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (Rule::filter(packets[i].data, packets[i].length))
+                this->dispatch(packets[i]);
+        }
+    }
+
+private:
+    void dispatch(const PacketView &packet)
+    {
+        if (!this->wantsResults())
+            return;
+        int index = Rule::classify(packet.data, packet.length);
+        if (Rule::hasClassify && index < 0)
+            return;
+        // 字段数在编译期已知，结果放在栈上
+        FieldValue fields[Rule::maxFields > 0 ? Rule::maxFields : 1];
+        size_t count = 0;
+        if (!Rule::decode(index, packet.data, packet.length, fields, count))
+            return;
+
+        ParseResult result;
+        result.protocol = Rule::protocol;
+        result.message = Rule::messageName(index);
+        result.messageIndex = index;
+        result.packet = &packet;
+        result.fields = fields;
+        result.fieldCount = count;
+        this->emit(result);
+    }
+};
+#endif
@@ -0,0 +1,104 @@
+#ifndef _StreamBuffer_hpp_
+#define _StreamBuffer_hpp_
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// @brief 可增长的字节环形缓冲区，用于 TCP 流重组
+/// 追加与消费只移动读写位置，不做 memmove；容量不足时按 2 的幂扩容并在扩容时线性化一次。
+/// 读取跨越环尾的区间时才拷贝到调用方提供的临时缓冲区。
+class StreamBuffer
+{
+public:
+    explicit StreamBuffer(size_t initial_capacity = 4096)
+    {
+        size_t capacity = 1;
+        while (capacity < initial_capacity)
+            capacity <<= 1;
+        this->storage.resize(capacity);
+        this->mask = capacity - 1;
+    }
+
+    size_t size() const { return this->tail - this->head; }
+    bool empty() const { return this->tail == this->head; }
+    size_t capacity() const { return this->storage.size(); }
+    uint8_t at(size_t index) const { return this->storage[(this->head + index) & this->mask]; }
+
+    void append(const uint8_t *data, size_t length)
+    {
+        if (this->size() + length > this->capacity())
+            this->grow(this->size() + length);
+        auto pos = this->tail & this->mask;
+        auto first = std::min(length, this->capacity() - pos);
+        std::memcpy(this->storage.data() + pos, data, first);
+        std::memcpy(this->storage.data(), data + first, length - first);
+        this->tail += length;
+    }
+
+    /// @brief 取 [index, index + length) 的连续地址，区间跨越环尾时拷贝到 scratch
+    const uint8_t *peek(size_t index, size_t length, std::vector<uint8_t> &scratch) const
+    {
+        auto pos = (this->head + index) & this->mask;
+        if (pos + length <= this->capacity())
+            return this->storage.data() + pos;
+        scratch.resize(length);
+        auto first = this->capacity() - pos;
+        std::memcpy(scratch.data(), this->storage.data() + pos, first);
+        std::memcpy(scratch.data() + first, this->storage.data(), length - first);
+        return scratch.data();
+    }
+
+    /// @brief 从 from 开始查找 pattern，返回相对读位置的下标，找不到返回 size()
+    size_t find(const uint8_t *pattern, size_t pattern_length, size_t from) const
+    {
+        for (size_t i = from; i + pattern_length <= this->size(); i++)
+        {
+            // 在当前连续段内用 memchr 跳到首字节
+            auto pos = (this->head + i) & this->mask;
+            auto segment = std::min(this->size() - i, this->capacity() - pos);
+            auto hit = static_cast<const uint8_t *>(std::memchr(this->storage.data() + pos, pattern[0], segment));
+            if (!hit)
+            {
+                i += segment - 1;
+                continue;
+            }
+            i += hit - (this->storage.data() + pos);
+            if (i + pattern_length > this->size())
+                break;
+            size_t j = 1;
+            while (j < pattern_length && this->at(i + j) == pattern[j])
+                j++;
+            if (j == pattern_length)
+                return i;
+        }
+        return this->size();
+    }
+
+    void consume(size_t length) { this->head += std::min(length, this->size()); }
+    void clear() { this->head = this->tail = 0; }
+
+private:
+    void grow(size_t required)
+    {
+        size_t capacity = this->capacity();
+        while (capacity < required)
+            capacity <<= 1;
+        std::vector<uint8_t> bigger(capacity);
+        auto used = this->size();
+        auto pos = this->head & this->mask;
+        auto first = std::min(used, this->capacity() - pos);
+        std::memcpy(bigger.data(), this->storage.data() + pos, first);
+        std::memcpy(bigger.data() + first, this->storage.data(), used - first);
+        this->storage.swap(bigger);
+        this->mask = capacity - 1;
+        this->head = 0;
+        this->tail = used;
+    }
+
+    std::vector<uint8_t> storage;
+    size_t mask = 0;
+    uint64_t head = 0; ///< 读位置，单调递增，取模后为下标
+    uint64_t tail = 0; ///< 写位置，单调递增
+};
+#endif
@@ -0,0 +1,242 @@
+#include "StreamFramer.hpp"
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+    // 连续内存上的字节源，与 StreamBuffer 提供相同的访问接口
+    struct ContiguousSource
+    {
+        const uint8_t *data;
+        size_t length;
+
+        size_t size() const { return length; }
+        uint8_t at(size_t index) const { return data[index]; }
+        size_t find(const uint8_t *pattern, size_t pattern_length, size_t from) const
+        {
+            std::string_view haystack(reinterpret_cast<const char *>(data), length);
+            auto pos = haystack.find(std::string_view(reinterpret_cast<const char *>(pattern), pattern_length), from);
+            return pos == std::string_view::npos ? length : pos;
+        }
+    };
+}
+
+FrameRule::FrameRule(const nlohmann::json &rule)
+{
+    auto framing = rule.find("framing");
+    if (framing == rule.end())
+        return;
+    if (!framing->is_object())
+        throw std::runtime_error("Protocol rule \"framing\" must be an object");
+
+    this->maxLength = framing->value("max-length", this->maxLength);
+    std::string typeName = framing->value("type", "none");
+    if (typeName == "none")
+    {
+        this->type = FrameType::FT_None;
+    }
+    else if (typeName == "fixed")
+    {
+        this->type = FrameType::FT_Fixed;
+        this->fixedLength = framing->at("length").get<size_t>();
+        if (this->fixedLength == 0)
+            throw std::runtime_error("Fixed frame length must be positive");
+    }
+    else if (typeName == "length-prefix")
+    {
+        this->type = FrameType::FT_LengthPrefix;
+        auto width = framing->at("width").get<int64_t>();
+        auto offset = framing->value("offset", int64_t(0));
+        if (width < 1 || width > 8)
+            throw std::runtime_error("Length field width must be 1~8 bytes");
+        if (offset < 0 || offset > UINT32_MAX)
+            throw std::runtime_error("Length field offset out of range");
+        this->lengthField.offset = static_cast<uint32_t>(offset);
+        this->lengthField.length = static_cast<uint16_t>(width);
+        this->lengthField.type = FieldType::FT_UInt;
+        std::string endian = framing->value("endian", "big");
+        if (endian != "big" && endian != "little")
+            throw std::runtime_error("Unsupported endian: " + endian);
+        this->lengthField.endian = endian == "big" ? Endian::ED_Big : Endian::ED_Little;
+        this->lengthAdjust = framing->value("adjust", offset + width);
+    }
+    else if (typeName == "delimiter")
+    {
+        this->type = FrameType::FT_Delimiter;
+        this->delimiter = framing->at("delimiter").get<std::string>();
+        if (this->delimiter.empty())
+            throw std::runtime_error("Frame delimiter must not be empty");
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported framing type: " + typeName);
+    }
+}
+
+StreamFramer::StreamFramer(const FrameRule &frame_rule) : frameRule(frame_rule)
+{
+}
+
+template <typename Source>
+int StreamFramer::measure(const Source &source, size_t &scan_from, size_t &frame_length, size_t &consume_length) const
+{
+    switch (this->frameRule.type)
+    {
+    case FrameType::FT_Fixed:
+        if (source.size() < this->frameRule.fixedLength)
+            return 0;
+        frame_length = consume_length = this->frameRule.fixedLength;
+        return 1;
+
+    case FrameType::FT_LengthPrefix:
+    {
+        const auto &field = this->frameRule.lengthField;
+        size_t headerLength = size_t(field.offset) + field.length;
+        if (source.size() < headerLength)
+            return 0;
+        uint8_t fieldBytes[8];
+        for (uint16_t i = 0; i < field.length; i++)
+            fieldBytes[i] = source.at(field.offset + i);
+        FieldDescriptor local = field;
+        local.offset = 0;
+        auto total = static_cast<int64_t>(RuleProgram::load(local, fieldBytes)) + this->frameRule.lengthAdjust;
+        if (total < static_cast<int64_t>(headerLength) || static_cast<size_t>(total) > this->frameRule.maxLength)
+            return -1;
+        if (source.size() < static_cast<size_t>(total))
+            return 0;
+        frame_length = consume_length = static_cast<size_t>(total);
+        return 1;
+    }
+
+    case FrameType::FT_Delimiter:
+    {
+        const auto *pattern = reinterpret_cast<const uint8_t *>(this->frameRule.delimiter.data());
+        auto patternLength = this->frameRule.delimiter.size();
+        auto pos = source.find(pattern, patternLength, scan_from);
+        if (pos == source.size())
+        {
+            if (source.size() > this->frameRule.maxLength)
+                return -1;
+            // 已扫描过的部分下次不再扫描，保留可能构成分隔符前缀的尾部
+            scan_from = source.size() >= patternLength ? source.size() - patternLength + 1 : 0;
+            return 0;
+        }
+        if (pos > this->frameRule.maxLength)
+            return -1;
+        frame_length = pos;
+        consume_length = pos + patternLength;
+        return 1;
+    }
+
+    default:
+        frame_length = consume_length = source.size();
+        return source.size() > 0 ? 1 : 0;
+    }
+}
+
+void StreamFramer::feed(const PacketView &chunk, const FrameCallback &frameCallback)
+{
+    if (this->frameRule.type == FrameType::FT_None)
+    {
+        this->frames++;
+        frameCallback(chunk);
+        return;
+    }
+
+    size_t frameLength = 0, consumeLength = 0;
+    if (this->buffer.empty())
+    {
+        // 快速路径：直接在数据块上分帧，完整的帧不经过环形缓冲区
+        size_t offset = 0;
+        size_t scanFrom = 0;
+        while (offset < chunk.length)
+        {
+            ContiguousSource rest{chunk.data + offset, chunk.length - offset};
+            scanFrom = 0;
+            int res = this->measure(rest, scanFrom, frameLength, consumeLength);
+            if (res < 0)
+            {
+                this->errors++;
+                this->dropped += rest.length;
+                return;
+            }
+            if (res == 0)
+                break;
+            if (frameLength > 0)
+            {
+                this->frames++;
+                PacketView frame(rest.data, frameLength, chunk.source, chunk.recvTime, chunk.streamId);
+                frame.slab = chunk.slab; // 帧仍在原数据块的缓冲区中，PacketRef 可直接持有
+                frameCallback(frame);
+            }
+            offset += consumeLength;
+        }
+        if (offset < chunk.length)
+        {
+            this->buffer.append(chunk.data + offset, chunk.length - offset);
+            this->scanFrom = scanFrom;
+        }
+        return;
+    }
+
+    this->buffer.append(chunk.data, chunk.length);
+    while (!this->buffer.empty())
+    {
+        int res = this->measure(this->buffer, this->scanFrom, frameLength, consumeLength);
+        if (res < 0)
+        {
+            this->errors++;
+            this->dropped += this->buffer.size();
+            this->reset();
+            return;
+        }
+        if (res == 0)
+            return;
+        if (frameLength > 0)
+        {
+            this->frames++;
+            frameCallback(PacketView(this->buffer.peek(0, frameLength, this->scratch), frameLength, chunk.source, chunk.recvTime, chunk.streamId));
+        }
+        this->buffer.consume(consumeLength);
+        this->scanFrom = 0;
+    }
+}
+
+void StreamFramer::reset()
+{
+    this->buffer.clear();
+    this->scanFrom = 0;
+}
+
+FramingStage::FramingStage(const nlohmann::json &rule, FrameCallback frame_callback)
+    : frameRule(rule), frameCallback(std::move(frame_callback))
+{
+}
+
+std::shared_ptr<StreamFramer> FramingStage::framerOf(uint64_t streamId)
+{
+    std::lock_guard<std::mutex> lock(this->streamMutex);
+    auto &framer = this->streams[streamId];
+    if (!framer)
+        framer = std::make_shared<StreamFramer>(this->frameRule);
+    return framer;
+}
+
+void FramingStage::feed(const PacketView &chunk)
+{
+    // 整个 feed 期间持有分帧器，其他线程上的 closeStream 不会在使用中释放它
+    auto framer = this->framerOf(chunk.streamId);
+    framer->feed(chunk, this->frameCallback);
+}
+
+void FramingStage::closeStream(uint64_t streamId)
+{
+    std::lock_guard<std::mutex> lock(this->streamMutex);
+    this->streams.erase(streamId);
+}
+
+size_t FramingStage::streamCount()
+{
+    std::lock_guard<std::mutex> lock(this->streamMutex);
+    return this->streams.size();
+}
@@ -0,0 +1,95 @@
+#ifndef _StreamFramer_hpp_
+#define _StreamFramer_hpp_
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "PacketView.hpp"
+#include "RuleProgram.hpp"
+#include "StreamBuffer.hpp"
+
+/// @brief 分帧方式
+enum class FrameType : uint8_t
+{
+    FT_None,         ///< 不分帧，收到的数据块原样交付
+    FT_Fixed,        ///< 固定长度
+    FT_LengthPrefix, ///< 包头长度字段
+    FT_Delimiter,    ///< 分隔符结尾
+};
+
+/// @brief 由 json 规则中 "framing" 编译得到的分帧规则
+/// 示例：
+///   {"type": "fixed", "length": 64}
+///   {"type": "length-prefix", "offset": 2, "width": 2, "endian": "big", "adjust": 4, "max-length": 65536}
+///   {"type": "delimiter", "delimiter": "\r\n", "max-length": 8192}
+/// length-prefix 的帧总长 = 长度字段值 + adjust，adjust 缺省为 offset + width（长度字段只计其后的字节）
+struct FrameRule
+{
+    FrameType type = FrameType::FT_None;
+    size_t fixedLength = 0;         ///< FT_Fixed 的帧长
+    FieldDescriptor lengthField;    ///< FT_LengthPrefix 的长度字段
+    int64_t lengthAdjust = 0;       ///< FT_LengthPrefix 帧总长的修正值
+    std::string delimiter;          ///< FT_Delimiter 的分隔符，交付的帧不含分隔符
+    size_t maxLength = 65536;       ///< 超过该长度视为失步
+
+    FrameRule() = default;
+    /// @param rule 协议规则，读取其中的 framing，不合法时抛出 std::runtime_error
+    explicit FrameRule(const nlohmann::json &rule);
+};
+
+using FrameCallback = std::function<void(const PacketView &frame)>;
+
+/// @brief 单条字节流的分帧器，非线程安全，同一条流的数据块应在同一线程上顺序送入
+class StreamFramer
+{
+public:
+    explicit StreamFramer(const FrameRule &frame_rule);
+
+    /// @brief 送入一个数据块，每凑齐一帧回调一次
+    /// 缓冲区为空时直接在数据块上分帧，只有不完整的尾部才进入环形缓冲区
+    void feed(const PacketView &chunk, const FrameCallback &frameCallback);
+    void reset();
+
+    uint64_t frameCount() const { return frames; }
+    uint64_t errorCount() const { return errors; }
+    uint64_t droppedBytes() const { return dropped; }
+
+private:
+    /// @brief 计算 source 开头一帧的长度
+    /// @return 1 帧已完整，0 数据不足，-1 失步
+    template <typename Source>
+    int measure(const Source &source, size_t &scan_from, size_t &frame_length, size_t &consume_length) const;
+
+    FrameRule frameRule;
+    StreamBuffer buffer;
+    std::vector<uint8_t> scratch; ///< 跨越环尾的帧的临时线性化空间
+    size_t scanFrom = 0;          ///< 分隔符已扫描到的位置，避免重复扫描
+    uint64_t frames = 0;
+    uint64_t errors = 0;
+    uint64_t dropped = 0;
+};
+
+/// @brief TcpSocket 与 ProtocolManager 之间的分帧层，按 PacketView::streamId 为每条连接维护分帧状态
+/// 由 ProtocolManager::attachStream 创建：数据块经 feed 分帧，TcpSocket 的流关闭回调调用 closeStream
+class FramingStage
+{
+public:
+    FramingStage(const nlohmann::json &rule, FrameCallback frame_callback);
+
+    void feed(const PacketView &chunk); ///< 可在多个接收线程上调用，同一 streamId 需来自同一线程
+    /// 连接关闭后释放其分帧状态（含未凑齐的半帧）；与 feed 并发时，正在进行的 feed 用完后才释放
+    void closeStream(uint64_t streamId);
+    size_t streamCount(); ///< 当前持有分帧状态的连接数
+
+private:
+    std::shared_ptr<StreamFramer> framerOf(uint64_t streamId);
+
+    FrameRule frameRule;
+    FrameCallback frameCallback;
+    std::mutex streamMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<StreamFramer>> streams;
+};
+#endif